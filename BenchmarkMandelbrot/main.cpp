@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "colors.hpp"
+#include "mandelbrot.hpp"
+
+// Microbenchmarks of the server's per pixel kernels on a fixed set of scenes,
+// so that a change to a kernel can be measured before it ships. Every kernel
+// runs a few times untimed, then repeatedly timed; the median run is reported.
+
+struct Scene {
+    std::string name;
+    Viewport view;
+    int iterations;
+};
+
+// Inputs and outputs of one scene, computed before timing starts.
+struct Workload {
+    Scene scene;
+    std::vector<uint32_t> counters;
+    uint64_t iterations;
+    std::vector<char> rgb;
+};
+
+struct Kernel {
+    std::string name;
+    // Runs over the whole workload and returns a checksum of what it computed.
+    std::function<uint64_t(Workload &)> run;
+    bool countsIterations;
+};
+
+struct Statistics {
+    double min;
+    double median;
+    double mean;
+    double deviation;
+};
+
+// The scenes span the workloads the server sees, from pixels escaping at once
+// to pixels never escaping.
+std::vector<Scene> scenes(int width, int height) {
+    auto view = [width, height](double centerX, double centerY, double viewWidth) {
+        double viewHeight = viewWidth * height / width;
+        return Viewport{width, height, centerX - viewWidth / 2, centerY + viewHeight / 2,
+                        centerX + viewWidth / 2, centerY - viewHeight / 2};
+    };
+    std::vector<Scene> list = {
+            {"home", Viewport{width, height, -2, 1.5, 0.5, -1.5}, 0},
+            {"seahorse", view(-0.7453, 0.1127, 0.006), 0},
+            {"minibrot", view(-1.2926258241427295, 0.35266703551337267, 1.5e-5), 0},
+            {"interior", view(-0.15, 0, 0.3), 0},
+            {"exterior", view(2.5, 2.5, 1), 0},
+    };
+    for (Scene &scene : list)
+        scene.iterations = iterationCap(scene.view);
+    return list;
+}
+
+std::vector<Kernel> kernels() {
+    return {
+            {"inMandelbrot", [](Workload &work) {
+                const Viewport &view = work.scene.view;
+                const double stepX = view.stepX();
+                const double stepY = view.stepY();
+                uint64_t sum = 0;
+                for (int y = 0; y < view.height; y++)
+                    for (int x = 0; x < view.width; x++)
+                        sum += inMandelbrot(view.leftTopX + x * stepX, view.leftTopY - y * stepY,
+                                            work.scene.iterations);
+                return sum;
+            }, true},
+            {"RGBColor", [](Workload &work) {
+                uint64_t sum = 0;
+                for (uint32_t counter : work.counters) {
+                    colors::RGB color = colors::RGBColor(counter, work.scene.iterations);
+                    sum += color.R + color.G + color.B;
+                }
+                return sum;
+            }, false},
+            {"Palette", [](Workload &work) {
+                colors::Palette(work.scene.iterations).paint(work.counters.data(), work.counters.size(),
+                                                             work.rgb.data());
+                uint64_t sum = 0;
+                for (char channel : work.rgb)
+                    sum += (unsigned char) channel;
+                return sum;
+            }, false},
+    };
+}
+
+Workload prepare(const Scene &scene) {
+    Workload work{scene, {}, 0, {}};
+    const Viewport &view = scene.view;
+    work.counters.resize(size_t(view.width) * view.height);
+    for (int y = 0; y < view.height; y++)
+        for (int x = 0; x < view.width; x++) {
+            uint32_t counter = inMandelbrot(view.leftTopX + x * view.stepX(), view.leftTopY - y * view.stepY(),
+                                            scene.iterations);
+            work.counters[size_t(y) * view.width + x] = counter;
+            work.iterations += counter;
+        }
+    work.rgb.resize(work.counters.size() * 3);
+    return work;
+}
+
+Statistics statistics(std::vector<double> seconds) {
+    std::sort(seconds.begin(), seconds.end());
+    Statistics result{seconds.front(), seconds[seconds.size() / 2], 0, 0};
+    for (double time : seconds)
+        result.mean += time / seconds.size();
+    for (double time : seconds)
+        result.deviation += (time - result.mean) * (time - result.mean) / seconds.size();
+    result.deviation = std::sqrt(result.deviation);
+    return result;
+}
+
+void printUsage(const char *program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl
+              << "  --size WxH      pixels per scene (default 512x512)" << std::endl
+              << "  --warmup N      untimed runs of every kernel (default 2)" << std::endl
+              << "  --repeat N      timed runs of every kernel (default 10)" << std::endl
+              << "  --scene NAME    only this scene, may be given more than once" << std::endl
+              << "  --kernel NAME   only this kernel, may be given more than once" << std::endl;
+}
+
+bool selected(const std::vector<std::string> &names, const std::string &name) {
+    return names.empty() || std::find(names.begin(), names.end(), name) != names.end();
+}
+
+int main(int argc, char *argv[]) {
+    int width = 512;
+    int height = 512;
+    int warmup = 2;
+    int repeat = 10;
+    std::vector<std::string> onlyScenes;
+    std::vector<std::string> onlyKernels;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--size" && hasValue && std::sscanf(argv[++i], "%dx%d", &width, &height) == 2) {
+        } else if (option == "--warmup" && hasValue) {
+            warmup = std::atoi(argv[++i]);
+        } else if (option == "--repeat" && hasValue) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (option == "--scene" && hasValue) {
+            onlyScenes.push_back(argv[++i]);
+        } else if (option == "--kernel" && hasValue) {
+            onlyKernels.push_back(argv[++i]);
+        } else {
+            std::cout << "Unknown option " << option << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::printf("%-9s %-13s %6s %10s %10s %10s %8s %12s %12s %10s %20s\n", "scene", "kernel", "iters",
+                "min ms", "median ms", "mean ms", "stddev%", "Mpixels/s", "Giters/s", "ns/iter", "checksum");
+    for (const Scene &scene : scenes(width, height)) {
+        if (!selected(onlyScenes, scene.name))
+            continue;
+        Workload work = prepare(scene);
+        for (const Kernel &kernel : kernels()) {
+            if (!selected(onlyKernels, kernel.name))
+                continue;
+            uint64_t checksum = 0;
+            for (int run = 0; run < warmup; run++)
+                checksum = kernel.run(work);
+            std::vector<double> seconds;
+            for (int run = 0; run < repeat; run++) {
+                auto begin_time = std::chrono::steady_clock::now();
+                checksum = kernel.run(work);
+                std::chrono::duration<double> diff = std::chrono::steady_clock::now() - begin_time;
+                seconds.push_back(diff.count());
+            }
+            Statistics time = statistics(seconds);
+            double pixels = double(work.counters.size());
+            std::printf("%-9s %-13s %6d %10.3f %10.3f %10.3f %8.2f %12.2f ", scene.name.c_str(),
+                        kernel.name.c_str(), scene.iterations, time.min * 1e3, time.median * 1e3, time.mean * 1e3,
+                        100 * time.deviation / time.mean, pixels / time.median / 1e6);
+            if (kernel.countsIterations)
+                std::printf("%12.3f %10.3f", work.iterations / time.median / 1e9,
+                            time.median / work.iterations * 1e9);
+            else
+                std::printf("%12s %10s", "-", "-");
+            std::printf(" %20llu\n", (unsigned long long) checksum);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#!/bin/sh
+# Strong and weak scaling of the server over rank counts 1 to MAX_RANKS.
+#
+# Usage: BenchmarkMandelbrot/scaling.sh [MAX_RANKS] [REPEAT]
+#
+# Every run renders a fixed scene in batch mode to /dev/null and reports the
+# "Server: // Timing" line of rank 0; the fastest of REPEAT runs counts.
+# Strong scaling keeps the image size fixed, weak scaling keeps the pixels
+# per worker fixed by making the image taller with the number of workers.
+# With one rank, rank 0 computes alone; with more, ranks 1..N-1 compute.
+# For a single node the server has to be built with UPCXX_NETWORK=smp.
+#
+# Environment: SERVER (default target/ServerMandelbrot), UPCXX_RUNNER
+# (default upcxx-run), SIZE (strong scaling image, default 2048x2048) and
+# WEAK_SIZE (image per worker for weak scaling, default 1024x512).
+
+MAX_RANKS=${1:-$(nproc)}
+REPEAT=${2:-3}
+SERVER=${SERVER:-target/ServerMandelbrot}
+UPCXX_RUNNER=${UPCXX_RUNNER:-upcxx-run}
+SIZE=${SIZE:-2048x2048}
+WEAK_SIZE=${WEAK_SIZE:-1024x512}
+
+SCENES="home:-2 1.5 0.5 -1.5
+seahorse:-0.7483 0.1157 -0.7423 0.1097
+minibrot:-1.29263332 0.35267453 -1.29261832 0.35265953"
+
+# Prints the timing line of the fastest of REPEAT runs: RANKS SIZE VIEW...
+run() {
+    ranks=$1
+    size=$2
+    shift 2
+    best=""
+    i=0
+    while [ $i -lt "$REPEAT" ]; do
+        line=$("$UPCXX_RUNNER" -n "$ranks" "$SERVER" --output /dev/null --png-threads 0 --size "$size" \
+                --view "$@" | grep "Server: // Timing")
+        if [ -z "$line" ]; then
+            echo "scaling.sh: no timing from $ranks ranks" >&2
+            exit 1
+        fi
+        total=$(echo "$line" | sed 's/.*total=\([^ ]*\).*/\1/')
+        if [ -z "$best" ] || awk "BEGIN { exit !($total < $best_total) }"; then
+            best=$line
+            best_total=$total
+        fi
+        i=$((i + 1))
+    done
+    echo "$best"
+}
+
+# Turns timing lines into a table row. BASE is the total of one rank.
+row() {
+    echo "$2" | awk -v scene="$1" -v base="$3" -v weak="$4" '{
+        for (i = 1; i <= NF; i++) {
+            split($i, pair, "=")
+            value[pair[1]] = pair[2]
+        }
+        speedup = weak ? base / value["total"] * value["workers"] : base / value["total"]
+        printf "%-9s %5d %7d %11d %9.3f %9.3f %9.3f %9.3f %8.2f %10.1f%%\n", scene, value["ranks"],
+               value["workers"], value["pixels"], value["total"], value["compute"], value["gather"],
+               value["output"], speedup, 100 * speedup / value["workers"]
+    }'
+}
+
+header() {
+    echo
+    echo "$1"
+    printf "%-9s %5s %7s %11s %9s %9s %9s %9s %8s %11s\n" scene ranks workers pixels "total s" "compute s" \
+        "gather s" "output s" speedup efficiency
+}
+
+header "Strong scaling, $SIZE per run"
+echo "$SCENES" | while IFS=: read -r name view; do
+    base=""
+    ranks=1
+    while [ $ranks -le "$MAX_RANKS" ]; do
+        # shellcheck disable=SC2086
+        line=$(run $ranks "$SIZE" $view) || exit 1
+        total=$(echo "$line" | sed 's/.*total=\([^ ]*\).*/\1/')
+        [ -z "$base" ] && base=$total
+        row "$name" "$line" "$base" 0
+        ranks=$((ranks + 1))
+    done
+done
+
+header "Weak scaling, $WEAK_SIZE per worker (speedup counts pixels per second)"
+width=${WEAK_SIZE%x*}
+height=${WEAK_SIZE#*x}
+echo "$SCENES" | while IFS=: read -r name view; do
+    base=""
+    ranks=1
+    while [ $ranks -le "$MAX_RANKS" ]; do
+        workers=$((ranks > 1 ? ranks - 1 : 1))
+        # shellcheck disable=SC2086
+        line=$(run $ranks "${width}x$((height * workers))" $view) || exit 1
+        total=$(echo "$line" | sed 's/.*total=\([^ ]*\).*/\1/')
+        [ -z "$base" ] && base=$total
+        row "$name" "$line" "$base" 1
+        ranks=$((ranks + 1))
+    done
+done
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Throughput of the ways a frame can travel from the server to the client.
+// A forked child plays the server: it answers every small request with a
+// frame from memory, so only the transfer is timed, from sending the request
+// to having the whole frame in the client's buffer.
+
+struct FrameSize {
+    std::string name;
+    int width;
+    int height;
+};
+
+struct Format {
+    std::string name;
+    int bytesPerPixel;
+};
+
+// Request sized like the client's Request.
+struct Message {
+    char bytes[64];
+};
+
+void fail(const std::string &what) {
+    std::cerr << "Transport benchmark: " << what << " failed: " << std::strerror(errno) << std::endl;
+    std::exit(1);
+}
+
+void writeFully(int fileDescriptor, const char *bytes, size_t size) {
+    while (size > 0) {
+        ssize_t status = write(fileDescriptor, bytes, size);
+        if (status == -1 && errno == EINTR)
+            continue;
+        if (status <= 0)
+            fail("write");
+        bytes += status;
+        size -= status;
+    }
+}
+
+// False once the other side has closed its end.
+bool readFully(int fileDescriptor, char *bytes, size_t size) {
+    while (size > 0) {
+        ssize_t status = read(fileDescriptor, bytes, size);
+        if (status == -1 && errno == EINTR)
+            continue;
+        if (status == -1)
+            fail("read");
+        if (status == 0)
+            return false;
+        bytes += status;
+        size -= status;
+    }
+    return true;
+}
+
+// One transport: a channel for requests and one for frames, set up before
+// the fork, with what each side does per frame.
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    virtual std::string name() const = 0;
+
+    // In the child, after the fork.
+    virtual void serve(const std::vector<char> &frame) {
+        Message request;
+        while (readFully(requestRead, request.bytes, sizeof(request)))
+            sendFrame(frame);
+    }
+
+    // In the parent: one request and the frame it brings.
+    void fetch(std::vector<char> &frame) {
+        Message request = {};
+        writeFully(requestWrite, request.bytes, sizeof(request));
+        receiveFrame(frame);
+    }
+
+    // Which ends each side keeps.
+    virtual void parentSide() {
+        close(requestRead);
+        close(responseWrite);
+    }
+
+    virtual void childSide() {
+        close(requestWrite);
+        close(responseRead);
+    }
+
+    void finish() {
+        close(requestWrite);
+        close(responseRead);
+    }
+
+protected:
+    virtual void sendFrame(const std::vector<char> &frame) {
+        writeFully(responseWrite, frame.data(), frame.size());
+    }
+
+    virtual void receiveFrame(std::vector<char> &frame) {
+        if (!readFully(responseRead, frame.data(), frame.size()))
+            fail("reading a frame");
+    }
+
+    int requestRead = -1;
+    int requestWrite = -1;
+    int responseRead = -1;
+    int responseWrite = -1;
+};
+
+// Named pipes like /tmp/.req and /tmp/.resp, with the kernel's pipe buffer
+// resized when bufferSize is not 0.
+class FifoTransport : public Transport {
+public:
+    explicit FifoTransport(int bufferSize) : bufferSize(bufferSize) {
+        std::string prefix = "/tmp/.transport_benchmark_" + std::to_string(getpid());
+        requestPath = prefix + "_req";
+        responsePath = prefix + "_resp";
+        if (mkfifo(requestPath.c_str(), 0600) != 0 || mkfifo(responsePath.c_str(), 0600) != 0)
+            fail("mkfifo");
+        // Opened read-write so that opening does not wait for the other side.
+        requestRead = requestWrite = open(requestPath.c_str(), O_RDWR);
+        responseRead = responseWrite = open(responsePath.c_str(), O_RDWR);
+        if (requestRead == -1 || responseRead == -1)
+            fail("opening the FIFOs");
+        if (bufferSize > 0 && fcntl(responseRead, F_SETPIPE_SZ, bufferSize) == -1)
+            fail("resizing the pipe buffer to " + std::to_string(bufferSize));
+        unlink(requestPath.c_str());
+        unlink(responsePath.c_str());
+    }
+
+    std::string name() const override {
+        return bufferSize > 0 ? "fifo " + std::to_string(bufferSize >> 10) + "K" : "fifo";
+    }
+
+    // Both sides hold both ends of a FIFO opened read-write, so none is closed.
+    void parentSide() override {}
+
+    void childSide() override {}
+
+private:
+    int bufferSize;
+    std::string requestPath;
+    std::string responsePath;
+};
+
+// A Unix domain stream socket, with its send and receive buffers resized
+// when bufferSize is not 0.
+class SocketTransport : public Transport {
+public:
+    explicit SocketTransport(int bufferSize) : bufferSize(bufferSize) {
+        int requests[2];
+        int responses[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, requests) != 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, responses) != 0)
+            fail("socketpair");
+        requestWrite = requests[0];
+        requestRead = requests[1];
+        responseWrite = responses[0];
+        responseRead = responses[1];
+        if (bufferSize > 0 && (setsockopt(responseWrite, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(int)) != 0 ||
+                               setsockopt(responseRead, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(int)) != 0))
+            fail("resizing the socket buffers");
+    }
+
+    std::string name() const override {
+        return bufferSize > 0 ? "socket " + std::to_string(bufferSize >> 10) + "K" : "socket";
+    }
+
+private:
+    int bufferSize;
+};
+
+// A shared memory block the size of the largest frame. The server writes the
+// frame into it and says so with one byte over a pipe, the client copies it
+// out. With copy false the client uses the frame in place.
+class SharedMemoryTransport : public Transport {
+public:
+    SharedMemoryTransport(size_t capacity, bool copy) : capacity(capacity), copy(copy) {
+        void *address = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED)
+            fail("mmap");
+        shared = static_cast<char *>(address);
+        int requests[2];
+        int responses[2];
+        if (pipe(requests) != 0 || pipe(responses) != 0)
+            fail("pipe");
+        requestRead = requests[0];
+        requestWrite = requests[1];
+        responseRead = responses[0];
+        responseWrite = responses[1];
+    }
+
+    ~SharedMemoryTransport() override {
+        munmap(shared, capacity);
+    }
+
+    std::string name() const override {
+        return copy ? "shm copy" : "shm in place";
+    }
+
+protected:
+    void sendFrame(const std::vector<char> &frame) override {
+        std::memcpy(shared, frame.data(), frame.size());
+        char ready = 1;
+        writeFully(responseWrite, &ready, 1);
+    }
+
+    void receiveFrame(std::vector<char> &frame) override {
+        char ready;
+        if (!readFully(responseRead, &ready, 1))
+            fail("waiting for a frame");
+        if (copy)
+            std::memcpy(frame.data(), shared, frame.size());
+        else
+            checksum += shared[frame.size() - 1];
+    }
+
+private:
+    char *shared;
+    size_t capacity;
+    bool copy;
+    volatile char checksum = 0;
+};
+
+// Milliseconds of every frame fetched over the transport.
+std::vector<double> measure(Transport &transport, size_t frameBytes, int frames) {
+    std::vector<char> frame(frameBytes);
+    for (size_t i = 0; i < frame.size(); i++)
+        frame[i] = char(i * 2654435761u >> 24);
+    pid_t child = fork();
+    if (child == -1)
+        fail("fork");
+    if (child == 0) {
+        transport.childSide();
+        transport.serve(frame);
+        std::_Exit(0);
+    }
+    transport.parentSide();
+
+    std::vector<char> received(frameBytes);
+    std::vector<double> milliseconds;
+    // the first frame warms up the buffers and page tables
+    transport.fetch(received);
+    for (int n = 0; n < frames; n++) {
+        auto begin_time = std::chrono::steady_clock::now();
+        transport.fetch(received);
+        std::chrono::duration<double, std::milli> diff = std::chrono::steady_clock::now() - begin_time;
+        milliseconds.push_back(diff.count());
+    }
+    if (transport.name() != "shm in place" && received != frame) {
+        std::cerr << "Transport benchmark: " << transport.name() << " delivered a different frame" << std::endl;
+        std::exit(1);
+    }
+    transport.finish();
+    // the FIFOs stay open in the child, which has to be told to go
+    kill(child, SIGTERM);
+    waitpid(child, nullptr, 0);
+    return milliseconds;
+}
+
+void printUsage(const char *program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl
+              << "  --frames N      timed frames per transport and size (default 20)" << std::endl
+              << "  --max-size NAME largest frame: 720p, 1080p, 1440p, 4K or 8K (default 8K)" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    int frames = 20;
+    std::string maxSize = "8K";
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--frames" && hasValue) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else if (option == "--max-size" && hasValue) {
+            maxSize = argv[++i];
+        } else {
+            std::cout << "Unknown option " << option << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    std::vector<FrameSize> sizes = {{"720p", 1280, 720}, {"1080p", 1920, 1080}, {"1440p", 2560, 1440},
+                                    {"4K", 3840, 2160}, {"8K", 7680, 4320}};
+    std::vector<Format> formats = {{"rgb", 3}, {"iterations", 4}};
+    signal(SIGPIPE, SIG_IGN);
+
+    std::printf("%-6s %-10s %-13s %10s %10s %10s %10s\n", "size", "format", "transport", "MB", "p50 ms", "p95 ms",
+                "MB/s");
+    for (const FrameSize &size : sizes) {
+        for (const Format &format : formats) {
+            size_t frameBytes = size_t(size.width) * size.height * format.bytesPerPixel;
+            std::vector<Transport *> transports = {
+                    new FifoTransport(0), new FifoTransport(1 << 20),
+                    new SocketTransport(0), new SocketTransport(4 << 20),
+                    new SharedMemoryTransport(frameBytes, true), new SharedMemoryTransport(frameBytes, false)};
+            for (Transport *transport : transports) {
+                std::vector<double> milliseconds = measure(*transport, frameBytes, frames);
+                std::sort(milliseconds.begin(), milliseconds.end());
+                double median = milliseconds[milliseconds.size() / 2];
+                double p95 = milliseconds[std::min(milliseconds.size() - 1, milliseconds.size() * 95 / 100)];
+                std::printf("%-6s %-10s %-13s %10.2f %10.3f %10.3f %10.1f\n", size.name.c_str(), format.name.c_str(),
+                            transport->name().c_str(), frameBytes / 1e6, median, p95,
+                            frameBytes / 1e6 / (median / 1e3));
+                delete transport;
+            }
+        }
+        if (size.name == maxSize)
+            break;
+    }
+    return 0;
+}
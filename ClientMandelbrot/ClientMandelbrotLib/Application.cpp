@@ -1,8 +1,10 @@
 #include "Application.h"
 
 #include "Exception.h"
+#include "logger.hpp"
 
 #include <SDL2/SDL.h>
+#include <chrono>
 #include <exception>
 
 
@@ -12,9 +14,15 @@ struct WindowOpeningFailedException : Exception {
 
 Application::Application(const std::string &applicationName,
                          const std::string &requestImagePipePath,
-                         const std::string &retrieveImagePipePath)
+                         const std::string &retrieveImagePipePath,
+                         const std::string &sessionPath,
+                         const std::string &latencyPath)
         : requestImagePipe(requestImagePipePath),
-          responseImagePipe(retrieveImagePipePath) {
+          responseImagePipe(retrieveImagePipePath),
+          latencyPath(latencyPath) {
+    if (!sessionPath.empty()) {
+        sessionRecorder.reset(new SessionRecorder(sessionPath));
+    }
     SDL_Init(SDL_INIT_VIDEO);
     window = SDL_CreateWindow(
             applicationName.c_str(),
@@ -69,7 +77,20 @@ void Application::start() {
         handlePipes();
         render();
     }
+    if (!latencyPath.empty()) {
+        reportLatency();
+    }
+}
 
+void Application::reportLatency() {
+    if (latencyPath.empty()) {
+        for (const std::string &line : latencyTracker.report()) {
+            LOG(Info) << "Client: // Latency  // " << line;
+        }
+        return;
+    }
+    latencyTracker.dump(latencyPath);
+    LOG(Info) << "Client: // Latency  // Wrote " << latencyTracker.frames() << " frames to " << latencyPath;
 }
 
 void Application::remapCoordinates() {
@@ -125,17 +146,27 @@ void Application::handlePipes() {
             applicationState.leftTopX,
             applicationState.leftTopY,
             applicationState.rightBottomX,
-            applicationState.rightBottomY
+            applicationState.rightBottomY,
+            FrameRequest,
+            0,
+            DebugView(applicationState.debugView)
     };
 
+    latencyTracker.sent(std::chrono::steady_clock::now());
     requestImagePipe.sendRequest(imageRequest);
     if (!applicationState.running) return;
     responseImagePipe.readResponse(currentImage, applicationState.windowWidth, applicationState.windowHeight);
+    latencyTracker.received(responseImagePipe.firstByteTime(), responseImagePipe.lastByteTime());
+    statsOverlay.update(responseImagePipe.frameStats(), responseImagePipe.rankSeconds());
+    if (sessionRecorder) {
+        sessionRecorder->record(applicationState.requestAction, imageRequest);
+    }
 }
 
 void Application::handleEvents() {
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
+        bool requested = applicationState.requestImage;
         switch (event.type) {
             case SDL_QUIT:
                 applicationState.running = false;
@@ -155,6 +186,20 @@ void Application::handleEvents() {
                         applicationState.windowHeight
                 );
                 applicationState.requestImage = true;
+                applicationState.requestAction = "resize";
+                break;
+            case SDL_KEYDOWN:
+                if (event.key.keysym.sym == SDLK_s && !event.key.repeat) {
+                    applicationState.showStats = !applicationState.showStats;
+                }
+                if (event.key.keysym.sym == SDLK_l && !event.key.repeat) {
+                    reportLatency();
+                }
+                if (event.key.keysym.sym == SDLK_d && !event.key.repeat) {
+                    applicationState.debugView = (applicationState.debugView + 1) % (CostView + 1);
+                    applicationState.requestImage = true;
+                    applicationState.requestAction = "debug";
+                }
                 break;
             case SDL_MOUSEMOTION:
                 applicationState.secondMouseClick = std::make_pair(
@@ -171,6 +216,7 @@ void Application::handleEvents() {
                     applicationState.keyDown = true;
                 }
                 if (event.button.button == SDL_BUTTON_RIGHT) {
+                    applicationState.requestAction = "undo";
                     if (lifoCoordinates.empty()) {
                         ApplicationState defaultState;
                         applicationState.leftTopX = defaultState.leftTopX;
@@ -183,7 +229,17 @@ void Application::handleEvents() {
                         applicationState.leftTopY = previousState.leftTopY;
                         applicationState.rightBottomX = previousState.rightBottomX;
                         applicationState.rightBottomY = previousState.rightBottomY;
+                        // Same window size and debug view: the kept image can be shown without asking the server,
+                        // unless a request is queued already, like that of a D pressed in the same batch of events.
+                        applicationState.requestImage = applicationState.requestImage ||
+                                                        !lifoCoordinates.restoreTopImage(
+                                                                currentImage,
+                                                                applicationState.windowWidth,
+                                                                applicationState.windowHeight,
+                                                                applicationState.debugView
+                                                        );
                         lifoCoordinates.pop();
+                        break;
                     }
                     applicationState.requestImage = true;
                 }
@@ -191,11 +247,18 @@ void Application::handleEvents() {
             case SDL_MOUSEBUTTONUP:
                 if (event.button.button != SDL_BUTTON_LEFT) break;
                 applicationState.keyDown = false;
-                lifoCoordinates.push(applicationState);
+                // The image is only worth keeping if it is not waiting for a refresh.
+                lifoCoordinates.push(applicationState, currentImage, !applicationState.requestImage);
                 applicationState.remapCoordinates = true;
                 applicationState.requestImage = true;
+                applicationState.requestAction = "zoom";
                 break;
         }
+        if (!requested && applicationState.requestImage) {
+            // SDL stamps events in milliseconds of its own clock, so the time spent in its queue is counted too.
+            Uint32 queued = SDL_GetTicks() - event.common.timestamp;
+            latencyTracker.input(std::chrono::steady_clock::now() - std::chrono::milliseconds(queued));
+        }
     }
 }
 
@@ -209,6 +272,7 @@ void Application::render() {
                     &*currentImage.begin(),
                     applicationState.windowWidth * 3
             );
+    latencyTracker.uploaded(std::chrono::steady_clock::now());
 
     SDL_RenderCopy(renderer, texture, nullptr, nullptr);
     if (applicationState.keyDown) {
@@ -220,6 +284,10 @@ void Application::render() {
         SDL_RenderDrawRect(renderer, &outline);
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
     }
+    if (applicationState.showStats) {
+        statsOverlay.draw(renderer);
+    }
     SDL_RenderPresent(renderer);
+    latencyTracker.presented(std::chrono::steady_clock::now());
 }
 
@@ -1,19 +1,27 @@
 #pragma once
 
 #include <SDL2/SDL.h>
+#include <memory>
 #include <string>
 #include <vector>
-#include <stack>
 #include "ApplicationState.h"
 #include "DataRequestNamedPipe.h"
 #include "DataResponseNamedPipe.h"
+#include "LatencyTracker.h"
+#include "Session.h"
+#include "SnapshotStack.h"
+#include "StatsOverlay.h"
 
 class Application {
 
 public:
+    // With a session path every frame requested is recorded to that file, see SessionRecorder.
+    // With a latency path the input to photon latencies are written to that file on L and on exit.
     Application(const std::string &applicationName,
                 const std::string &requestImagePipePath,
-                const std::string &retrieveImagePipePath);
+                const std::string &retrieveImagePipePath,
+                const std::string &sessionPath = "",
+                const std::string &latencyPath = "");
 
     virtual ~Application() noexcept;
 
@@ -27,12 +35,19 @@ public:
 
     void render();
 
+    // Writes the latencies to the latency path, or logs them without one.
+    void reportLatency();
+
 private:
     DataRequestNamedPipe requestImagePipe;
     DataResponseNamedPipe responseImagePipe;
     ApplicationState applicationState;
     std::vector<Pixel> currentImage;
-    std::stack<ApplicationState> lifoCoordinates;
+    SnapshotStack lifoCoordinates;
+    std::unique_ptr<SessionRecorder> sessionRecorder;
+    StatsOverlay statsOverlay;
+    LatencyTracker latencyTracker;
+    std::string latencyPath;
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
@@ -1,12 +1,19 @@
 #pragma once
 
+#include <string>
 #include <utility>
 
 struct ApplicationState {
     bool running = true;
     bool requestImage = true;
+    // What the user did to need the requested image, for session recordings.
+    std::string requestAction = "start";
     bool remapCoordinates = false;
     bool keyDown = false;
+    // Frame statistics of the server over the image, toggled with S.
+    bool showStats = false;
+    // DebugView asked of the server, cycled with D.
+    int debugView = 0;
     int windowHeight = 720;
     int windowWidth = 600;
     double leftTopX = -2;
@@ -1,40 +1,34 @@
 #pragma once
 
 #include "Exception.h"
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <iostream>
+#include "logger.hpp"
+#include "protocol.hpp"
 #include <fcntl.h>
 
-struct Request {
-    bool connectionOk;
-    int windowWidth;
-    int windowHeight;
-    double leftTopX;
-    double leftTopY;
-    double rightBottomX;
-    double rightBottomY;
-};
-
 class DataRequestNamedPipe {
 public:
     virtual ~DataRequestNamedPipe() {
-        std::cout << "Client: // Request  // Closing named pipe " << path << std::endl;
+        LOG(Info) << "Client: // Request  // Closing named pipe " << path;
         close(fileDescriptor);
-        std::cout << "Client: // Request  // Closed named pipe " << path << std::endl;
+        LOG(Info) << "Client: // Request  // Closed named pipe " << path;
         unlink(path.c_str());
-        std::cout << "Client: // Request  // Removing FIFO inode " << path << std::endl;
+        LOG(Info) << "Client: // Request  // Removing FIFO inode " << path;
     }
 
     explicit DataRequestNamedPipe(const std::string &path): path(path) {
         mkfifo(path.c_str(), 0777); // Ignore failure
-        std::cout << "Client: // Request // Opening named pipe " << path << " , waiting for writer.." << std::endl;
+        LOG(Info) << "Client: // Request // Opening named pipe " << path << " , waiting for writer..";
         fileDescriptor = open(path.c_str(), O_WRONLY);
         if (fileDescriptor == -1) {
             throw CannotOpenNamedPipeException(path);
         }
-        std::cout << "Client: // Request // Opened named pipe " << path << " !" << std::endl;
+        LOG(Info) << "Client: // Request // Opened named pipe " << path << " !";
     }
 
     void sendRequest(const Request &request) {
@@ -44,7 +38,37 @@ public:
         }
     }
 
+    // Asks only for the pixels of the given regions of the request's window.
+    void sendRegionRequest(Request request, const std::vector<Region> &regions) {
+        request.requestType = RegionRequest;
+        request.regionCount = regions.size();
+        sendWithItems(request, regions);
+    }
+
+    // Asks for many viewports at once, such as thumbnails, which the server computes together.
+    void sendViewportsRequest(const std::vector<Viewport> &viewports) {
+        Request request = {true, 0, 0, 0, 0, 0, 0, ViewportsRequest, int(viewports.size()), NoDebugView};
+        sendWithItems(request, viewports);
+    }
+
     const std::string path;
     int fileDescriptor;
+
+private:
+    template<typename Item>
+    void sendWithItems(const Request &request, const std::vector<Item> &items) {
+        std::vector<char> message(sizeof(Request) + items.size() * sizeof(Item));
+        std::copy((const char *) &request, (const char *) (&request + 1), message.begin());
+        std::copy((const char *) items.data(), (const char *) (items.data() + items.size()),
+                  message.begin() + sizeof(Request));
+        size_t bytesWritten = 0;
+        while (bytesWritten < message.size()) {
+            int status = write(fileDescriptor, message.data() + bytesWritten, message.size() - bytesWritten);
+            if (status == -1) {
+                throw CannotWriteToNamedPipeException(path);
+            }
+            bytesWritten += status;
+        }
+    }
 };
 
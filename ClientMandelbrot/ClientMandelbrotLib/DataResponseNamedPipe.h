@@ -1,48 +1,122 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <unistd.h>
 #include <sys/stat.h>
-#include <iostream>
 #include <fcntl.h>
+#include <vector>
 #include "Exception.h"
+#include "DataRequestNamedPipe.h"
+#include "logger.hpp"
 #include "Pixel.h"
 
 class DataResponseNamedPipe {
 public:
     virtual ~DataResponseNamedPipe() {
-        std::cout << "Client: // Response // Closing named pipe " << path << std::endl;
+        LOG(Info) << "Client: // Response // Closing named pipe " << path;
         close(fileDescriptor);
-        std::cout << "Client: // Response // Closed named pipe " << path << std::endl;
+        LOG(Info) << "Client: // Response // Closed named pipe " << path;
         unlink(path.c_str());
-        std::cout << "Client: // Response // Removing FIFO inode " << path << std::endl;
+        LOG(Info) << "Client: // Response // Removing FIFO inode " << path;
     }
 
     explicit DataResponseNamedPipe(const std::string &path): path(path){
         mkfifo(path.c_str(), 0777); // Ignore failure
-        std::cout << "Client: // Response // Opening named pipe " << path << " , waiting for writer.." << std::endl;
+        LOG(Info) << "Client: // Response // Opening named pipe " << path << " , waiting for writer..";
         fileDescriptor = open(path.c_str(), O_RDONLY);
         if (fileDescriptor == -1) {
             throw CannotOpenNamedPipeException(path);
         }
-        std::cout << "Client: // Response // Opened named pipe " << path << " !" << std::endl;
+        LOG(Info) << "Client: // Response // Opened named pipe " << path << " !";
     }
 
     void readResponse(std::vector<Pixel> &image, int width, int height) {
-        if (image.size() != width * height) {
-            image.resize(width * height);
+        if (image.size() != size_t(width) * height) {
+            image.resize(size_t(width) * height);
         }
+        awaitingFirstByte = true;
+        readBytes((uint8_t *) image.data(), image.size() * sizeof(Pixel));
+        readStats();
+    }
+
+    // Pixels of the regions sent with DataRequestNamedPipe::sendRegionRequest(),
+    // one region after another, each clipped to the window.
+    void readRegionsResponse(std::vector<Pixel> &pixels, const std::vector<Region> &regions,
+                             int width, int height) {
+        awaitingFirstByte = true;
+        size_t count = 0;
+        for (const Region &region : regions) {
+            Region clipped = clip(region, Viewport{width, height, 0, 0, 0, 0});
+            count += size_t(clipped.width) * clipped.height;
+        }
+        pixels.resize(count);
+        readBytes((uint8_t *) pixels.data(), pixels.size() * sizeof(Pixel));
+        readStats();
+    }
+
+    // Images of the viewports sent with DataRequestNamedPipe::sendViewportsRequest(), in the same order.
+    void readViewportsResponse(std::vector<std::vector<Pixel>> &images, const std::vector<Viewport> &viewports) {
+        awaitingFirstByte = true;
+        images.resize(viewports.size());
+        for (size_t n = 0; n < viewports.size(); n++) {
+            images[n].resize(size_t(std::max(viewports[n].width, 0)) * std::max(viewports[n].height, 0));
+            readBytes((uint8_t *) images[n].data(), images[n].size() * sizeof(Pixel));
+        }
+        readStats();
+    }
+
+    // Cost of the last response read.
+    const FrameStats &frameStats() const {
+        return stats;
+    }
+
+    // Compute seconds of every server rank for the last response read.
+    const std::vector<double> &rankSeconds() const {
+        return ranks;
+    }
+
+    // When the first read of the last response returned, and when its last byte was read.
+    std::chrono::steady_clock::time_point firstByteTime() const {
+        return firstByte;
+    }
+
+    std::chrono::steady_clock::time_point lastByteTime() const {
+        return lastByte;
+    }
+
+    const std::string path;
+    int fileDescriptor;
 
-        int bytesToBeRead = image.size() * sizeof(Pixel);
+private:
+    void readStats() {
+        readBytes((uint8_t *) &stats, sizeof(FrameStats));
+        ranks.resize(std::max(stats.rankCount, 0));
+        readBytes((uint8_t *) ranks.data(), ranks.size() * sizeof(double));
+        lastByte = std::chrono::steady_clock::now();
+    }
+
+    void readBytes(uint8_t *bytes, size_t bytesToBeRead) {
         int bytesReadInIteration = 0;
-        for (int bytesRead = 0; bytesRead < bytesToBeRead; bytesRead += bytesReadInIteration) {
-            bytesReadInIteration = read(fileDescriptor, (uint8_t *)(&*image.begin()) + bytesRead, bytesToBeRead);
+        for (size_t bytesRead = 0; bytesRead < bytesToBeRead; bytesRead += bytesReadInIteration) {
+            bytesReadInIteration = read(fileDescriptor, bytes + bytesRead, bytesToBeRead - bytesRead);
             if (bytesReadInIteration == -1) {
                 throw CannotReadFromNamedPipeException(path);
             }
+            if (bytesReadInIteration == 0) {
+                throw CannotReadFromNamedPipeException(path + " closed by the server");
+            }
+            if (awaitingFirstByte) {
+                awaitingFirstByte = false;
+                firstByte = std::chrono::steady_clock::now();
+            }
         }
     }
 
-    const std::string path;
-    int fileDescriptor;
+    FrameStats stats = {};
+    std::vector<double> ranks;
+    bool awaitingFirstByte = false;
+    std::chrono::steady_clock::time_point firstByte;
+    std::chrono::steady_clock::time_point lastByte;
 };
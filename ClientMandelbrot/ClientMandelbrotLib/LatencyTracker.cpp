@@ -0,0 +1,133 @@
+#include "LatencyTracker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+const char *StageNames[LatencyStageCount] = {"queue", "server", "transfer", "upload", "present", "total"};
+
+// Upper bounds of the histogram buckets in milliseconds, doubling from 0.25,
+// the last bucket takes everything above.
+const int BucketCount = 16;
+
+double bucketBound(int bucket) {
+    return 0.25 * (1 << bucket);
+}
+
+}
+
+double percentile(const std::vector<double> &sorted, double fraction) {
+    size_t rank = size_t(fraction * sorted.size() + 0.999999);
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+void LatencyTracker::input(Clock::time_point time) {
+    if (reached != 0) {
+        return;
+    }
+    times[0] = time;
+    reached = 1;
+}
+
+void LatencyTracker::sent(Clock::time_point time) {
+    if (reached != 1) {
+        return;
+    }
+    times[1] = time;
+    reached = 2;
+}
+
+void LatencyTracker::received(Clock::time_point firstByte, Clock::time_point lastByte) {
+    if (reached != 2) {
+        return;
+    }
+    times[2] = firstByte;
+    times[3] = lastByte;
+    reached = 4;
+}
+
+void LatencyTracker::uploaded(Clock::time_point time) {
+    if (reached != 4) {
+        return;
+    }
+    times[4] = time;
+    reached = 5;
+}
+
+void LatencyTracker::presented(Clock::time_point time) {
+    if (reached != 5) {
+        return;
+    }
+    times[5] = time;
+    reached = 0;
+    std::array<double, LatencyStageCount> milliseconds;
+    for (int stage = 0; stage < TotalStage; stage++) {
+        milliseconds[stage] = std::chrono::duration<double, std::milli>(times[stage + 1] - times[stage]).count();
+    }
+    milliseconds[TotalStage] = std::chrono::duration<double, std::milli>(times[TotalStage] - times[0]).count();
+    window.push_back(milliseconds);
+    if (window.size() > WindowSize) {
+        window.pop_front();
+    }
+}
+
+std::vector<std::string> LatencyTracker::report() const {
+    std::vector<std::string> lines;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-9s %6s %10s %10s %10s %10s %10s", "stage", "frames", "p50 ms", "p95 ms",
+                  "p99 ms", "mean ms", "max ms");
+    lines.push_back(line);
+    if (window.empty()) {
+        return lines;
+    }
+    std::vector<std::array<int, BucketCount>> histogram(LatencyStageCount);
+    for (int stage = 0; stage < LatencyStageCount; stage++) {
+        std::vector<double> sorted;
+        double sum = 0;
+        histogram[stage].fill(0);
+        for (const auto &frame : window) {
+            sorted.push_back(frame[stage]);
+            sum += frame[stage];
+            int bucket = 0;
+            while (bucket < BucketCount - 1 && frame[stage] > bucketBound(bucket)) {
+                bucket++;
+            }
+            histogram[stage][bucket]++;
+        }
+        std::sort(sorted.begin(), sorted.end());
+        std::snprintf(line, sizeof(line), "%-9s %6zu %10.2f %10.2f %10.2f %10.2f %10.2f", StageNames[stage],
+                      sorted.size(), percentile(sorted, 0.5), percentile(sorted, 0.95), percentile(sorted, 0.99),
+                      sum / sorted.size(), sorted.back());
+        lines.push_back(line);
+    }
+    int length = std::snprintf(line, sizeof(line), "%-9s", "<= ms");
+    for (int stage = 0; stage < LatencyStageCount; stage++) {
+        length += std::snprintf(line + length, sizeof(line) - length, " %8s", StageNames[stage]);
+    }
+    lines.push_back(line);
+    for (int bucket = 0; bucket < BucketCount; bucket++) {
+        if (bucket < BucketCount - 1) {
+            length = std::snprintf(line, sizeof(line), "%-9g", bucketBound(bucket));
+        } else {
+            length = std::snprintf(line, sizeof(line), "%-9s", "more");
+        }
+        for (int stage = 0; stage < LatencyStageCount; stage++) {
+            length += std::snprintf(line + length, sizeof(line) - length, " %8d", histogram[stage][bucket]);
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+void LatencyTracker::dump(const std::string &path) const {
+    std::ofstream file(path);
+    file << "# input to photon latency of the last " << window.size() << " frames" << std::endl;
+    for (const std::string &line : report()) {
+        file << line << std::endl;
+    }
+    if (!file) {
+        throw CannotWriteLatencyException(path);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+#include "Exception.h"
+
+struct CannotWriteLatencyException : Exception {
+    explicit CannotWriteLatencyException(const std::string &message) : Exception(message) {}
+};
+
+// Nearest rank percentile of values sorted in ascending order, not empty.
+double percentile(const std::vector<double> &sorted, double fraction);
+
+// Parts of the time from an input that needs a new frame until that frame is
+// on the screen, each from the end of the previous one.
+enum LatencyStage {
+    // input until the request is written, mostly waiting in the event queue
+    QueueStage,
+    // until the first read of the response returns: transport and server
+    ServerStage,
+    // until the last byte of the response is read
+    TransferStage,
+    // until the image is uploaded to the texture
+    UploadStage,
+    // until the renderer presents it
+    PresentStage,
+    TotalStage,
+    LatencyStageCount,
+};
+
+// Input to photon latency of the last frames the user asked for, as
+// percentiles and a histogram of every stage. Frames the client restores
+// without asking the server, like undo from a kept image, are not counted.
+class LatencyTracker {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Frames kept for the percentiles and histogram, older ones are forgotten.
+    static const size_t WindowSize = 512;
+
+    // Starts a frame at the time of the input, unless one is already under way.
+    void input(Clock::time_point time);
+
+    // The stages of the frame under way, ignored when there is none.
+    void sent(Clock::time_point time);
+
+    void received(Clock::time_point firstByte, Clock::time_point lastByte);
+
+    void uploaded(Clock::time_point time);
+
+    // Ends the frame under way.
+    void presented(Clock::time_point time);
+
+    size_t frames() const {
+        return window.size();
+    }
+
+    // Percentiles of every stage, then frames per histogram bucket, in milliseconds.
+    std::vector<std::string> report() const;
+
+    void dump(const std::string &path) const;
+
+private:
+    // Times of the frame under way, one per stage end.
+    std::array<Clock::time_point, TotalStage + 1> times;
+    // The stages of the frame under way that already ended, 0 with none under way.
+    int reached = 0;
+    std::deque<std::array<double, LatencyStageCount>> window;
+};
@@ -0,0 +1,111 @@
+#include "Session.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include "DataResponseNamedPipe.h"
+#include "LatencyTracker.h"
+#include "logger.hpp"
+
+SessionRecorder::SessionRecorder(const std::string &path) : path(path), file(path) {
+    if (!file) {
+        throw CannotWriteSessionException(path);
+    }
+    file << "# action width height leftTopX leftTopY rightBottomX rightBottomY debugView" << std::endl;
+    file.precision(std::numeric_limits<double>::max_digits10);
+}
+
+void SessionRecorder::record(const std::string &action, const Request &request) {
+    file << action << " " << request.windowWidth << " " << request.windowHeight << " "
+         << request.leftTopX << " " << request.leftTopY << " "
+         << request.rightBottomX << " " << request.rightBottomY << " " << int(request.debugView) << std::endl;
+    if (!file) {
+        throw CannotWriteSessionException(path);
+    }
+}
+
+std::vector<SessionStep> readSession(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw CannotReadSessionException(path);
+    }
+    std::vector<SessionStep> steps;
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        SessionStep step{"", Request{true, 0, 0, 0, 0, 0, 0, FrameRequest, 0, NoDebugView}};
+        Request &request = step.request;
+        // Sessions recorded before debug views end after the bounds.
+        int debugView = NoDebugView;
+        if (!(fields >> step.action >> request.windowWidth >> request.windowHeight >> request.leftTopX
+                     >> request.leftTopY >> request.rightBottomX >> request.rightBottomY) ||
+            (!(fields >> debugView) && !fields.eof()) || debugView < NoDebugView || debugView > CostView) {
+            throw CannotReadSessionException(path + ":" + std::to_string(number) + " is not a session step");
+        }
+        request.debugView = DebugView(debugView);
+        steps.push_back(step);
+    }
+    return steps;
+}
+
+namespace {
+
+void printLatencies(const std::string &action, std::vector<double> milliseconds) {
+    std::sort(milliseconds.begin(), milliseconds.end());
+    double sum = 0;
+    for (double latency : milliseconds) {
+        sum += latency;
+    }
+    std::printf("%-8s %6zu %10.2f %10.2f %10.2f %10.2f %10.2f\n", action.c_str(), milliseconds.size(),
+                percentile(milliseconds, 0.5), percentile(milliseconds, 0.95), percentile(milliseconds, 0.99),
+                sum / milliseconds.size(), milliseconds.back());
+}
+
+}
+
+void replaySession(const std::vector<SessionStep> &steps, int repeat,
+                   const std::string &requestPipePath, const std::string &responsePipePath) {
+    DataRequestNamedPipe requestPipe(requestPipePath);
+    DataResponseNamedPipe responsePipe(responsePipePath);
+    std::vector<Pixel> image;
+    std::map<std::string, std::vector<double>> latencies;
+    std::vector<double> all;
+    size_t bytes = 0;
+
+    auto begin_time = std::chrono::steady_clock::now();
+    for (int round = 0; round < repeat; round++) {
+        for (const SessionStep &step : steps) {
+            auto sent_time = std::chrono::steady_clock::now();
+            requestPipe.sendRequest(step.request);
+            responsePipe.readResponse(image, step.request.windowWidth, step.request.windowHeight);
+            std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - sent_time;
+            latencies[step.action].push_back(latency.count());
+            all.push_back(latency.count());
+            bytes += image.size() * sizeof(Pixel);
+        }
+    }
+    std::chrono::duration<double> total = std::chrono::steady_clock::now() - begin_time;
+
+    Request quit{false, 0, 0, 0, 0, 0, 0, FrameRequest, 0, NoDebugView};
+    requestPipe.sendRequest(quit);
+
+    // the pipes' lines come first, not halfway through the report
+    logging::Logger::instance().flush();
+    std::printf("%-8s %6s %10s %10s %10s %10s %10s\n", "action", "frames", "p50 ms", "p95 ms", "p99 ms",
+                "mean ms", "max ms");
+    for (const auto &action : latencies) {
+        printLatencies(action.first, action.second);
+    }
+    if (!all.empty()) {
+        printLatencies("all", all);
+    }
+    std::printf("%zu frames in %.3f s: %.2f frames/s, %.1f MB/s\n", all.size(), total.count(),
+                all.size() / total.count(), bytes / total.count() / (1 << 20));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "DataRequestNamedPipe.h"
+#include "Exception.h"
+
+struct CannotReadSessionException : Exception {
+    explicit CannotReadSessionException(const std::string &message) : Exception(message) {}
+};
+struct CannotWriteSessionException : Exception {
+    explicit CannotWriteSessionException(const std::string &message) : Exception(message) {}
+};
+
+// One frame the client asked the server for, and what the user did to need it:
+// start, zoom, undo, resize or debug.
+struct SessionStep {
+    std::string action;
+    Request request;
+};
+
+// Session files hold one step per line:
+// ACTION WIDTH HEIGHT LEFT_TOP_X LEFT_TOP_Y RIGHT_BOTTOM_X RIGHT_BOTTOM_Y [DEBUG_VIEW]
+// DEBUG_VIEW is a DebugView, none when left out. Lines starting with # are comments.
+class SessionRecorder {
+public:
+    explicit SessionRecorder(const std::string &path);
+
+    void record(const std::string &action, const Request &request);
+
+private:
+    std::string path;
+    std::ofstream file;
+};
+
+std::vector<SessionStep> readSession(const std::string &path);
+
+// Sends the frame requests of a session to the server as fast as it answers
+// them, repeat times over, without opening a window. Prints the latency
+// percentiles of every action and the frames per second of the whole replay,
+// then lets the server go.
+void replaySession(const std::vector<SessionStep> &steps, int repeat,
+                   const std::string &requestPipePath, const std::string &responsePipePath);
@@ -0,0 +1,91 @@
+#include "SnapshotStack.h"
+
+#include <cstring>
+
+SnapshotStack::SnapshotStack(size_t memoryCap) : memoryCap(memoryCap) {}
+
+void SnapshotStack::push(const ApplicationState &state, const std::vector<Pixel> &image, bool keepImage) {
+    Snapshot snapshot{state, false, {}};
+    if (keepImage && image.size() == size_t(state.windowWidth) * state.windowHeight) {
+        snapshot.image = encode(image);
+        snapshot.encoded = true;
+        if (snapshot.image.size() >= image.size() * sizeof(Pixel)) {
+            // Too noisy to compress, plain pixels are smaller.
+            snapshot.image.resize(image.size() * sizeof(Pixel));
+            std::memcpy(snapshot.image.data(), image.data(), snapshot.image.size());
+            snapshot.encoded = false;
+        }
+    }
+    used += snapshot.image.size();
+    snapshots.push_back(std::move(snapshot));
+    enforceCap();
+}
+
+void SnapshotStack::pop() {
+    used -= snapshots.back().image.size();
+    snapshots.pop_back();
+}
+
+bool SnapshotStack::empty() const {
+    return snapshots.empty();
+}
+
+const ApplicationState &SnapshotStack::top() const {
+    return snapshots.back().state;
+}
+
+bool SnapshotStack::restoreTopImage(std::vector<Pixel> &image, int width, int height, int debugView) const {
+    const Snapshot &snapshot = snapshots.back();
+    if (snapshot.image.empty() || snapshot.state.windowWidth != width || snapshot.state.windowHeight != height ||
+        snapshot.state.debugView != debugView) {
+        return false;
+    }
+    image.resize(size_t(width) * height);
+    if (snapshot.encoded) {
+        decode(snapshot.image, image);
+    } else {
+        std::memcpy(image.data(), snapshot.image.data(), snapshot.image.size());
+    }
+    return true;
+}
+
+size_t SnapshotStack::memoryUsed() const {
+    return used;
+}
+
+// Runs of up to 256 equal pixels, stored as (length - 1, red, green, blue).
+std::vector<uint8_t> SnapshotStack::encode(const std::vector<Pixel> &image) {
+    std::vector<uint8_t> encoded;
+    for (size_t i = 0; i < image.size();) {
+        const Pixel &pixel = image[i];
+        size_t run = 1;
+        while (run < 256 && i + run < image.size() && image[i + run].red == pixel.red &&
+               image[i + run].green == pixel.green && image[i + run].blue == pixel.blue) {
+            run++;
+        }
+        encoded.push_back(uint8_t(run - 1));
+        encoded.push_back(pixel.red);
+        encoded.push_back(pixel.green);
+        encoded.push_back(pixel.blue);
+        i += run;
+    }
+    encoded.shrink_to_fit();
+    return encoded;
+}
+
+void SnapshotStack::decode(const std::vector<uint8_t> &encoded, std::vector<Pixel> &image) {
+    size_t pixel = 0;
+    for (size_t i = 0; i + 3 < encoded.size() && pixel < image.size(); i += 4) {
+        size_t run = encoded[i] + 1;
+        for (size_t n = 0; n < run && pixel < image.size(); n++) {
+            image[pixel++] = Pixel{encoded[i + 1], encoded[i + 2], encoded[i + 3]};
+        }
+    }
+}
+
+void SnapshotStack::enforceCap() {
+    for (auto snapshot = snapshots.begin(); used > memoryCap && snapshot != snapshots.end(); ++snapshot) {
+        used -= snapshot->image.size();
+        std::vector<uint8_t>().swap(snapshot->image);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "ApplicationState.h"
+#include "Pixel.h"
+
+// Undo history. Every entry remembers the coordinates of a view and, while the
+// memory cap allows it, the run length encoded image rendered for it, so going
+// back does not have to ask the server again. Images of the oldest entries are
+// dropped first.
+class SnapshotStack {
+public:
+    explicit SnapshotStack(size_t memoryCap = 128 << 20);
+
+    void push(const ApplicationState &state, const std::vector<Pixel> &image, bool keepImage = true);
+
+    void pop();
+
+    bool empty() const;
+
+    const ApplicationState &top() const;
+
+    // Decodes the image of the top entry, provided it was kept and rendered for a window of this size
+    // in this debug view.
+    bool restoreTopImage(std::vector<Pixel> &image, int width, int height, int debugView) const;
+
+    size_t memoryUsed() const;
+
+private:
+    struct Snapshot {
+        ApplicationState state;
+        bool encoded;
+        std::vector<uint8_t> image;
+    };
+
+    static std::vector<uint8_t> encode(const std::vector<Pixel> &image);
+
+    static void decode(const std::vector<uint8_t> &encoded, std::vector<Pixel> &image);
+
+    void enforceCap();
+
+    std::deque<Snapshot> snapshots;
+    size_t memoryCap;
+    size_t used = 0;
+};
@@ -0,0 +1,142 @@
+#include "StatsOverlay.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+
+namespace {
+
+const int GlyphWidth = 5;
+const int GlyphHeight = 7;
+// Screen pixels per font pixel.
+const int Scale = 2;
+const int Margin = 4 * Scale;
+const int Advance = (GlyphWidth + 1) * Scale;
+const int LineHeight = (GlyphHeight + 2) * Scale;
+// Ranks listed one per line, the rest are summed up in one line.
+const size_t MaxRanksShown = 16;
+
+// Rows from the top, the highest of the five bits is the leftmost pixel.
+struct Glyph {
+    char character;
+    uint8_t rows[GlyphHeight];
+};
+
+const Glyph Font[] = {
+        {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+        {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+        {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+        {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+        {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+        {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+        {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+        {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+        {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+        {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+        {'A', {0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11}},
+        {'B', {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}},
+        {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+        {'D', {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}},
+        {'E', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}},
+        {'F', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}},
+        {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+        {'H', {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+        {'I', {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+        {'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}},
+        {'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+        {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+        {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+        {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+        {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+        {'P', {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}},
+        {'Q', {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}},
+        {'R', {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}},
+        {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+        {'T', {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+        {'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+        {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}},
+        {'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}},
+        {'X', {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}},
+        {'Y', {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}},
+        {'Z', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}},
+        {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+        {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+        {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+        {'+', {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}},
+        {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+        {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+        {'(', {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}},
+        {')', {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}},
+};
+
+const Glyph *findGlyph(char character) {
+    for (const Glyph &glyph : Font) {
+        if (glyph.character == character) {
+            return &glyph;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+void StatsOverlay::update(const FrameStats &stats, const std::vector<double> &rankSeconds) {
+    lines.clear();
+    char line[64];
+    std::snprintf(line, sizeof(line), "frame %.3f s  cap %d", stats.seconds, stats.iterationCap);
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "iterations %.1f M", stats.iterations / 1e6);
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "imbalance max %.1f%%  mean %.1f%%", 100 * stats.maxImbalance,
+                  100 * stats.meanImbalance);
+    lines.push_back(line);
+    // Rank 0 only computes when it is alone.
+    size_t first = rankSeconds.size() > 1 ? 1 : 0;
+    size_t last = std::min(rankSeconds.size(), first + MaxRanksShown);
+    for (size_t rank = first; rank < last; rank++) {
+        std::snprintf(line, sizeof(line), "rank %-3zu %.3f s", rank, rankSeconds[rank]);
+        lines.push_back(line);
+    }
+    if (last < rankSeconds.size()) {
+        std::snprintf(line, sizeof(line), "+%zu ranks", rankSeconds.size() - last);
+        lines.push_back(line);
+    }
+}
+
+void StatsOverlay::draw(SDL_Renderer *renderer) const {
+    if (lines.empty()) {
+        return;
+    }
+    size_t longest = 0;
+    for (const std::string &line : lines) {
+        longest = std::max(longest, line.size());
+    }
+    SDL_Rect background{0, 0, int(longest) * Advance + 2 * Margin, int(lines.size()) * LineHeight + 2 * Margin};
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+    SDL_RenderFillRect(renderer, &background);
+
+    std::vector<SDL_Rect> rects;
+    for (size_t n = 0; n < lines.size(); n++) {
+        addText(rects, lines[n], Margin, Margin + int(n) * LineHeight);
+    }
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
+    SDL_RenderFillRects(renderer, rects.data(), int(rects.size()));
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+}
+
+void StatsOverlay::addText(std::vector<SDL_Rect> &rects, const std::string &text, int x, int y) {
+    for (char character : text) {
+        const Glyph *glyph = findGlyph(char(std::toupper((unsigned char) character)));
+        for (int row = 0; glyph && row < GlyphHeight; row++) {
+            for (int column = 0; column < GlyphWidth; column++) {
+                if (glyph->rows[row] & (0x10 >> column)) {
+                    rects.push_back(SDL_Rect{x + column * Scale, y + row * Scale, Scale, Scale});
+                }
+            }
+        }
+        x += Advance;
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+#include "DataRequestNamedPipe.h"
+
+// What the last frame cost on the server, drawn in the top left corner of the
+// window with a built in 5x7 pixel font, so it needs no font files.
+class StatsOverlay {
+public:
+    void update(const FrameStats &stats, const std::vector<double> &rankSeconds);
+
+    void draw(SDL_Renderer *renderer) const;
+
+private:
+    // Adds the lit pixels of text at x, y to rects. Letters are shown in upper case.
+    static void addText(std::vector<SDL_Rect> &rects, const std::string &text, int x, int y);
+
+    std::vector<std::string> lines;
+};
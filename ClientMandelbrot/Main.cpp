@@ -1,9 +1,55 @@
 #include "Application.h"
+#include "Session.h"
+#include "logger.hpp"
 
-int main(){
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+void printUsage(const char *program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl
+              << "  --record FILE   record every frame requested during the session to FILE" << std::endl
+              << "  --replay FILE   replay a recorded session without a window and report latencies" << std::endl
+              << "  --repeat N      replay the session N times (default 1)" << std::endl
+              << "  --latency FILE  write the input to photon latencies to FILE on L and on exit" << std::endl
+              << "  --log-level L   error, warning, info (default) or debug" << std::endl
+              << "Keys: S shows what the last frame cost on the server," << std::endl
+              << "      D cycles through the server's rank ownership and tile cost views," << std::endl
+              << "      L reports the input to photon latencies of the last frames" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
     const char *params[] = {"MandelbrotClient", "/tmp/.req", "/tmp/.resp"};
+    std::string recordPath;
+    std::string replayPath;
+    std::string latencyPath;
+    int repeat = 1;
+    logging::Level logLevel = logging::Info;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--record") == 0 && hasValue) {
+            recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && hasValue) {
+            replayPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--latency") == 0 && hasValue) {
+            latencyPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue) {
+            repeat = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--log-level") == 0 && hasValue && logging::parseLevel(argv[i + 1], logLevel)) {
+            i++;
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    logging::Logger::instance().setProgram("Client");
+    logging::Logger::instance().setLevel(logLevel);
     try {
-        Application application(params[0], params[1], params[2]);
+        if (!replayPath.empty()) {
+            replaySession(readSession(replayPath), repeat, params[1], params[2]);
+            return 0;
+        }
+        Application application(params[0], params[1], params[2], recordPath, latencyPath);
         application.start();
     }
     catch(const std::exception& exception){
@@ -11,4 +57,3 @@ int main(){
         return -1;
     }
 }
-
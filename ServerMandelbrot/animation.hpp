@@ -0,0 +1,188 @@
+#ifndef ANIMATION_GUARD
+#define ANIMATION_GUARD
+
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "colors.hpp"
+#include "engine.hpp"
+#include "image_writer.hpp"
+#include "logger.hpp"
+#include "options.hpp"
+#include "trace.hpp"
+
+namespace animation{
+
+// Name of frame number index: the path is a pattern such as
+// frames/zoom_%05d.png, or gets _%05d inserted before its extension. The
+// pattern takes exactly one %d, optionally zero padded to a width of at most
+// 20, and %% for a percent sign. It is not handed to printf.
+inline std::string framePath(const std::string &pattern, int index){
+    if(pattern.find('%') == std::string::npos){
+        std::string format = pattern;
+        size_t dot = format.rfind('.');
+        size_t slash = format.rfind('/');
+        if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            dot = format.size();
+        format.insert(dot, "_%05d");
+        return framePath(format, index);
+    }
+    std::string path;
+    int numbers = 0;
+    bool valid = true;
+    for(size_t n = 0; n < pattern.size() && valid; n++){
+        if(pattern[n] != '%'){
+            path += pattern[n];
+            continue;
+        }
+        if(n + 1 < pattern.size() && pattern[n + 1] == '%'){
+            path += '%';
+            n++;
+            continue;
+        }
+        bool zeros = n + 1 < pattern.size() && pattern[n + 1] == '0';
+        size_t end = zeros ? n + 2 : n + 1;
+        size_t width = 0;
+        for(; end < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[end])) && width <= 20; end++)
+            width = width * 10 + (pattern[end] - '0');
+        valid = end < pattern.size() && (pattern[end] == 'd' || pattern[end] == 'i') && width <= 20;
+        std::string number = std::to_string(index);
+        if(number.size() < width)
+            path.append(width - number.size(), zeros ? '0' : ' ');
+        path += number;
+        numbers++;
+        n = end;
+    }
+    if(!valid || numbers != 1){
+        LOG(Error) << "Server: // Animate  // --output " << pattern << " needs exactly one %d for the frame number";
+        throw -1;
+    }
+    return path;
+}
+
+inline double ease(Easing easing, double t){
+    if(easing == Easing::Smooth)
+        return t * t * (3 - 2 * t);
+    return t;
+}
+
+// View at time t in [0, 1]. The size changes geometrically so that the zoom
+// looks equally fast all the way, and the center follows the size so that
+// the end view stays put on screen while we zoom into it.
+inline Viewport interpolate(const Viewport &from, const Viewport &to, double t){
+    double fromWidth = from.rightBottomX - from.leftTopX;
+    double fromHeight = from.leftTopY - from.rightBottomY;
+    double toWidth = to.rightBottomX - to.leftTopX;
+    double toHeight = to.leftTopY - to.rightBottomY;
+    double width = fromWidth * std::pow(toWidth / fromWidth, t);
+    double height = fromHeight * std::pow(toHeight / fromHeight, t);
+    double progress = std::fabs(toWidth - fromWidth) > 1e-300 ? (width - fromWidth) / (toWidth - fromWidth) : t;
+
+    double fromCenterX = (from.leftTopX + from.rightBottomX) / 2;
+    double fromCenterY = (from.leftTopY + from.rightBottomY) / 2;
+    double centerX = fromCenterX + ((to.leftTopX + to.rightBottomX) / 2 - fromCenterX) * progress;
+    double centerY = fromCenterY + ((to.leftTopY + to.rightBottomY) / 2 - fromCenterY) * progress;
+    return Viewport{from.width, from.height,
+                    centerX - width / 2, centerY + height / 2,
+                    centerX + width / 2, centerY - height / 2};
+}
+
+// Frames rendered by one engine call.
+struct Batch{
+    int firstFrame;
+    std::vector<int> iterations;
+    std::vector<engine::Job> jobs;
+};
+
+inline Batch frameBatch(const Options &options, int firstFrame, int frameCount){
+    Batch batch{firstFrame, {}, {}};
+    for(int frame = firstFrame; frame < firstFrame + frameCount; frame++){
+        double t = options.frames > 1 ? double(frame) / (options.frames - 1) : 0;
+        Viewport view = interpolate(options.view, options.endView, ease(options.easing, t));
+        int iterations = options.iterations > 0 ? options.iterations : iterationCap(view);
+        batch.iterations.push_back(iterations);
+        batch.jobs.push_back(engine::viewportJob(view, iterations));
+    }
+    return batch;
+}
+
+inline void writeBatch(const Options &options, const Batch &batch, const std::vector<uint32_t> &counters){
+    trace::Scope scope("write", int64_t(batch.jobs.size()));
+    const size_t framePixels = size_t(options.view.width) * options.view.height;
+    std::vector<char> rgb(framePixels * 3);
+    for(size_t n = 0; n < batch.jobs.size(); n++){
+        colors::Palette(batch.iterations[n]).paint(counters.data() + n * framePixels, framePixels, rgb.data());
+        std::string path = framePath(options.outputPath, batch.firstFrame + int(n));
+        std::unique_ptr<image::ImageWriter> writer = image::openImage(path, options.view.width, options.view.height);
+        writer->writeRows(rgb.data(), options.view.height);
+        writer->finish();
+    }
+}
+
+// Parameters of the whole animation, which its checkpoints belong to.
+inline std::string describe(const std::string &mode, const Options &options){
+    return checkpoint::describe(mode + " " + options.outputPath, options.view, options.iterations) + " to " +
+           checkpoint::describe(std::to_string(options.frames) + " frames", options.endView, int(options.easing));
+}
+
+// Renders options.frames frames from options.view to options.endView. Rank 0 only.
+// Every engine call carries a batch of frames, as many as there are workers,
+// whose rows are split between them by pixel count. Rank 0 writes out a batch
+// while the workers already compute the next one, but batches run in lockstep:
+// the next one is only handed out once every worker finished the current one,
+// so the worker with the dearest rows sets the pace.
+// A checkpoint holds the number of frames written.
+inline void render(engine::Engine &engine, const Options &options){
+    const int batchFrames = engine::Engine::workers();
+    // a bad --output stops the render before anything is computed
+    framePath(options.outputPath, 0);
+    checkpoint::Checkpoint progress(options.outputPath + ".checkpoint", describe("animation", options),
+                                    options.checkpointSeconds);
+    int startFrame = progress.resuming() ? progress.restored().get<int>() : 0;
+    LOG(Info) << "Server: // Animate  // " << options.frames << " frames of " << options.view.width << "x"
+              << options.view.height << ", " << batchFrames << " per batch";
+    if(startFrame > 0)
+        LOG(Info) << "Server: // Resume   // Carrying on from frame " << startFrame;
+    auto begin_time = std::chrono::steady_clock::now();
+
+    if(startFrame >= options.frames){
+        progress.remove();
+        return;
+    }
+    Batch current = frameBatch(options, startFrame, std::min(batchFrames, options.frames - startFrame));
+    engine.submit(current.jobs);
+    while(true){
+        std::vector<uint32_t> counters = engine.collect();
+        int nextFrame = current.firstFrame + int(current.jobs.size());
+        Batch next;
+        bool more = nextFrame < options.frames;
+        if(more){
+            next = frameBatch(options, nextFrame, std::min(batchFrames, options.frames - nextFrame));
+            engine.submit(next.jobs);
+        }
+        writeBatch(options, current, counters);
+        LOG(Info) << "Server: // Animate  // Wrote frames up to " << nextFrame - 1;
+        if(!more)
+            break;
+        if(progress.due()){
+            checkpoint::Record record;
+            record.put(nextFrame);
+            progress.save(record);
+        }
+        current = std::move(next);
+    }
+    progress.remove();
+
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - begin_time;
+    LOG(Info) << "Server: // Animate  // " << options.frames - startFrame << " frames took " << diff.count()
+              << " seconds (" << (options.frames - startFrame) / diff.count() << " frames/s)";
+}
+
+} // namespace animation
+
+#endif // ANIMATION_GUARD
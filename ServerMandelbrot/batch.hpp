@@ -0,0 +1,127 @@
+#ifndef BATCH_GUARD
+#define BATCH_GUARD
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "colors.hpp"
+#include "engine.hpp"
+#include "image_writer.hpp"
+#include "logger.hpp"
+#include "options.hpp"
+#include "trace.hpp"
+
+// Rows per band so that two bands in flight, iteration counts and colors,
+// stay within the memory budget.
+inline int bandRows(const Options &options) {
+    size_t bytesPerRow = size_t(options.view.width) * (sizeof(uint32_t) + 3) * 2;
+    size_t rows = std::max<size_t>(options.memoryBudgetBytes / bytesPerRow, 1);
+    return int(std::min<size_t>(rows, options.view.height));
+}
+
+inline engine::Job bandJob(const Options &options, int iterations, int firstRow, int rows) {
+    engine::Job job = engine::viewportJob(options.view, iterations);
+    job.y = firstRow;
+    job.height = rows;
+    return job;
+}
+
+// Renders the view from row startRow down in bands of rows and hands each
+// band's colors to write, top to bottom. Rank 0 only. While the workers compute one band, rank 0
+// colors and writes the previous one, so memory use does not grow with the
+// size of the image.
+inline void renderBands(engine::Engine &engine, const Options &options, int iterations, int startRow,
+                        int rowsPerBand, const std::function<void(const char *rgb, int firstRow, int rows)> &write) {
+    const Viewport &view = options.view;
+    colors::Palette palette(iterations);
+    std::vector<char> rgb;
+
+    int firstRow = startRow;
+    int rows = std::min(rowsPerBand, view.height - firstRow);
+    if (rows <= 0)
+        return;
+    engine.submit({bandJob(options, iterations, firstRow, rows)});
+    while (rows > 0) {
+        std::vector<uint32_t> counters = engine.collect();
+        int nextRow = firstRow + rows;
+        int nextRows = std::min(rowsPerBand, view.height - nextRow);
+        if (nextRows > 0)
+            engine.submit({bandJob(options, iterations, nextRow, nextRows)});
+
+        rgb.resize(counters.size() * 3);
+        {
+            trace::Scope scope("color", int64_t(counters.size()));
+            palette.paint(counters.data(), counters.size(), rgb.data());
+        }
+        {
+            trace::Scope scope("write", rows);
+            write(rgb.data(), firstRow, rows);
+        }
+        firstRow = nextRow;
+        rows = nextRows;
+    }
+}
+
+// Where rank 0's time went, as one line of key=value pairs for scripts such as
+// BenchmarkMandelbrot/scaling.sh. Output is coloring and writing, which
+// overlap with the workers computing the next band: overlap is how much of the
+// busiest worker's compute time rank 0 did not have to wait for.
+inline void printTimings(engine::Engine &engine, double totalSeconds) {
+    const engine::Engine::Phases &phases = engine.timings();
+    engine::Engine::Work work = engine.takeWork();
+    double busiest = 0;
+    for (size_t rank = 1; rank < work.rankSeconds.size(); rank++)
+        busiest = std::max(busiest, work.rankSeconds[rank]);
+    LOG(Info) << "Server: // Timing   // ranks=" << upcxx::rank_n() << " workers=" << engine::Engine::workers()
+              << " pixels=" << phases.pixels << " total=" << totalSeconds << " compute=" << phases.computeSeconds
+              << " gather=" << phases.gatherSeconds
+              << " output=" << totalSeconds - phases.computeSeconds - phases.gatherSeconds
+              << " overlap=" << std::max(busiest - phases.computeSeconds, 0.0);
+}
+
+// Renders the view given on the command line straight to an image file. Rank 0 only.
+// A checkpoint holds the rows written so far and the state of the writer.
+inline void renderToFile(engine::Engine &engine, const Options &options) {
+    const Viewport &view = options.view;
+    int iterations = options.iterationCap();
+    int rowsPerBand = bandRows(options);
+    checkpoint::Checkpoint progress(options.outputPath + ".checkpoint",
+                                    checkpoint::describe("image " + options.outputPath, view, iterations),
+                                    options.checkpointSeconds);
+    int startRow = 0;
+    image::WriterState resume{0, 0};
+    if (progress.resuming()) {
+        startRow = progress.restored().get<int>();
+        resume = progress.restored().get<image::WriterState>();
+        LOG(Info) << "Server: // Resume   // Carrying on from row " << startRow;
+    }
+    LOG(Info) << "Server: // Batch    // Rendering " << view.width << "x" << view.height << " of (" << view.leftTopX
+              << ", " << view.leftTopY << ") - (" << view.rightBottomX << ", " << view.rightBottomY << ") with "
+              << iterations << " iterations, " << rowsPerBand << " rows per band";
+
+    auto begin_time = std::chrono::steady_clock::now();
+    std::unique_ptr<image::ImageWriter> writer = image::openImage(options.outputPath, view.width, view.height,
+                                                                  progress.resuming() ? &resume : nullptr);
+    renderBands(engine, options, iterations, startRow, rowsPerBand, [&](const char *rgb, int firstRow, int rows) {
+        writer->writeRows(rgb, rows);
+        LOG(Info) << "Server: // Batch    // Wrote rows " << firstRow << " - " << firstRow + rows - 1;
+        if (progress.due()) {
+            checkpoint::Record record;
+            record.put(firstRow + rows);
+            record.put(writer->state());
+            progress.save(record);
+        }
+    });
+    writer->finish();
+    progress.remove();
+
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - begin_time;
+    LOG(Info) << "Server: // Batch    // Calculations took " << diff.count() << " seconds.";
+    LOG(Info) << "Server: // Batch    // Wrote " << options.outputPath;
+    printTimings(engine, diff.count());
+}
+
+#endif // BATCH_GUARD
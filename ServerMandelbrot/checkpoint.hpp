@@ -0,0 +1,160 @@
+#ifndef CHECKPOINT_GUARD
+#define CHECKPOINT_GUARD
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <unistd.h>
+
+#include "logger.hpp"
+#include "mandelbrot.hpp"
+
+// Progress of an offline render saved to a file now and then, so that a
+// render killed by a preempted job can be restarted and carry on from the
+// last checkpoint instead of from the beginning. A checkpoint only applies
+// to a render with the same parameters.
+namespace checkpoint{
+
+const char Magic[8] = {'M', 'B', 'C', 'H', 'E', 'C', 'K', '1'};
+
+// Fields of a checkpoint, read back in the order they were put.
+class Record{
+public:
+    Record() = default;
+
+    explicit Record(std::string bytes) : data(std::move(bytes)){}
+
+    template<typename T>
+    void put(const T &value){
+        data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void putBytes(const void *bytes, uint64_t size){
+        put(size);
+        data.append(static_cast<const char *>(bytes), size);
+    }
+
+    template<typename T>
+    T get(){
+        T value;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    std::string getBytes(){
+        uint64_t size = get<uint64_t>();
+        return std::string(take(size), size);
+    }
+
+    const std::string &bytes() const{ return data; }
+
+private:
+    const char *take(uint64_t size){
+        if(size > data.size() - offset){
+            LOG(Error) << "Server: // Resume   // Checkpoint is cut short";
+            throw -1;
+        }
+        offset += size;
+        return data.data() + offset - size;
+    }
+
+    std::string data;
+    size_t offset = 0;
+};
+
+// Parameters a checkpoint belongs to, written out exactly.
+inline std::string describe(const std::string &mode, const Viewport &view, int iterations){
+    std::ostringstream text;
+    text.precision(17);
+    text << mode << " " << view.width << "x" << view.height << " " << view.leftTopX << " " << view.leftTopY << " "
+         << view.rightBottomX << " " << view.rightBottomY << " " << iterations;
+    return text.str();
+}
+
+class Checkpoint{
+public:
+    // Checkpoints to path every interval seconds, never with an interval of 0.
+    Checkpoint(const std::string &path, const std::string &parameters, int interval)
+            : path(path), parameters(parameters), interval(interval), lastSave(std::chrono::steady_clock::now()){
+        if(interval > 0)
+            load();
+    }
+
+    bool enabled() const{ return interval > 0; }
+
+    // Whether there is progress to carry on from, found in restored().
+    bool resuming() const{ return found; }
+
+    Record &restored(){ return saved; }
+
+    bool due() const{
+        return enabled() && std::chrono::steady_clock::now() - lastSave >= std::chrono::seconds(interval);
+    }
+
+    // Replaces the checkpoint so that a crash leaves either the old or the new one.
+    void save(const Record &record){
+        if(!enabled())
+            return;
+        std::string temporary = path + ".tmp";
+        std::FILE *file = std::fopen(temporary.c_str(), "wb");
+        bool written = file && std::fwrite(Magic, 1, sizeof(Magic), file) == sizeof(Magic);
+        Record framed;
+        framed.putBytes(parameters.data(), parameters.size());
+        framed.putBytes(record.bytes().data(), record.bytes().size());
+        const std::string &bytes = framed.bytes();
+        written = written && std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        written = written && std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+        if(file)
+            written = std::fclose(file) == 0 && written;
+        if(!written || std::rename(temporary.c_str(), path.c_str()) != 0){
+            LOG(Error) << "Server: // Resume   // Writing checkpoint " << path << " failed. Errno: " << errno;
+            throw -1;
+        }
+        lastSave = std::chrono::steady_clock::now();
+    }
+
+    // The render is complete, there is nothing left to resume.
+    void remove(){
+        if(enabled())
+            std::remove(path.c_str());
+    }
+
+private:
+    void load(){
+        std::FILE *file = std::fopen(path.c_str(), "rb");
+        if(!file)
+            return;
+        std::string bytes;
+        char buffer[1 << 16];
+        for(size_t read; (read = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+            bytes.append(buffer, read);
+        std::fclose(file);
+        if(bytes.size() < sizeof(Magic) || bytes.compare(0, sizeof(Magic), Magic, sizeof(Magic)) != 0){
+            LOG(Warning) << "Server: // Resume   // " << path << " is not a checkpoint, starting over";
+            return;
+        }
+        Record framed(bytes.substr(sizeof(Magic)));
+        if(framed.getBytes() != parameters){
+            LOG(Warning) << "Server: // Resume   // " << path << " belongs to another render, starting over";
+            return;
+        }
+        saved = Record(framed.getBytes());
+        found = true;
+    }
+
+    std::string path;
+    std::string parameters;
+    int interval;
+    std::chrono::steady_clock::time_point lastSave;
+    Record saved;
+    bool found = false;
+};
+
+} // namespace checkpoint
+
+#endif // CHECKPOINT_GUARD
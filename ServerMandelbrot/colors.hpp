@@ -7,6 +7,9 @@
 #ifndef COLORS_GUARD
 #define COLORS_GUARD
 
+#include <cstdint>
+#include <vector>
+
 namespace colors{
 struct RGB{
     unsigned char R,G,B;
@@ -65,6 +68,32 @@ RGB RGBColor(int counter, int maxIterations){
     return HSV_to_RGB(H,S,V);
 }
 
+// Colors of every iteration count up to maxIterations, computed once per frame
+// so that coloring a pixel is a single table lookup.
+class Palette{
+public:
+    explicit Palette(int maxIterations) : colors(maxIterations + 1){
+        for(int counter = 0; counter <= maxIterations; counter++)
+            colors[counter] = RGBColor(counter, maxIterations);
+    }
+
+    const RGB &operator()(uint32_t counter) const{
+        return colors[counter];
+    }
+
+    void paint(const uint32_t *counters, size_t count, char *rgb) const{
+        for(size_t i = 0; i < count; i++){
+            const RGB &color = colors[counters[i]];
+            rgb[i * 3] = color.R;
+            rgb[i * 3 + 1] = color.G;
+            rgb[i * 3 + 2] = color.B;
+        }
+    }
+
+private:
+    std::vector<RGB> colors;
+};
+
 } // namespace colors
 
 #endif // COLORS_GUARD
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef DEBUG_VIEW_GUARD
+#define DEBUG_VIEW_GUARD
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "colors.hpp"
+#include "engine.hpp"
+#include "protocol.hpp"
+#include "tile_cache.hpp"
+
+// Debug views tint a colored frame, half and half, with who computed each
+// pixel or what each tile cost, to show how the engine balances its work.
+namespace debugview{
+
+// Hues a golden angle apart, so neighbouring ranks never look alike.
+inline colors::RGB rankColor(int rank){
+    return colors::HSV_to_RGB(static_cast<unsigned char>(rank * 158), 200, 255);
+}
+
+// From dark purple for the cheapest tile to pale yellow for the dearest.
+inline colors::RGB heatColor(double heat){
+    static const colors::RGB stops[] = {{0, 0, 4}, {87, 16, 110}, {188, 55, 84}, {249, 142, 9}, {252, 255, 164}};
+    const int last = sizeof(stops) / sizeof(stops[0]) - 1;
+    double position = std::min(std::max(heat, 0.0), 1.0) * last;
+    int stop = std::min(int(position), last - 1);
+    double fraction = position - stop;
+    const colors::RGB &from = stops[stop];
+    const colors::RGB &to = stops[stop + 1];
+    return {static_cast<unsigned char>(from.R + (to.R - from.R) * fraction),
+            static_cast<unsigned char>(from.G + (to.G - from.G) * fraction),
+            static_cast<unsigned char>(from.B + (to.B - from.B) * fraction)};
+}
+
+inline void blend(char *pixel, const colors::RGB &color){
+    pixel[0] = char((static_cast<unsigned char>(pixel[0]) + color.R) / 2);
+    pixel[1] = char((static_cast<unsigned char>(pixel[1]) + color.G) / 2);
+    pixel[2] = char((static_cast<unsigned char>(pixel[2]) + color.B) / 2);
+}
+
+// Tints every pixel of the jobs' result with the color of the rank the engine
+// handed its row to.
+inline void paintOwnership(const std::vector<engine::Job> &jobs, char *rgb){
+    std::vector<engine::Slice> slices = engine::partition(jobs, engine::Engine::workers());
+    for(size_t n = 0; n < slices.size(); n++){
+        colors::RGB color = rankColor(upcxx::rank_n() > 1 ? int(n) + 1 : 0);
+        for(int64_t pixel = slices[n].pixelBegin; pixel < slices[n].pixelEnd; pixel++)
+            blend(rgb + pixel * 3, color);
+    }
+}
+
+// Tints every TileSize x TileSize tile of a width x height frame by the
+// iterations its pixels took, relative to the dearest tile.
+inline void paintCost(const std::vector<uint32_t> &counters, int width, int height, char *rgb){
+    if(width <= 0 || height <= 0)
+        return;
+    int columns = (width + tiles::TileSize - 1) / tiles::TileSize;
+    int rows = (height + tiles::TileSize - 1) / tiles::TileSize;
+    std::vector<uint64_t> cost(size_t(columns) * rows, 0);
+    for(int y = 0; y < height; y++)
+        for(int x = 0; x < width; x++)
+            cost[(y / tiles::TileSize) * columns + x / tiles::TileSize] += counters[size_t(y) * width + x];
+    uint64_t dearest = std::max<uint64_t>(*std::max_element(cost.begin(), cost.end()), 1);
+    for(int y = 0; y < height; y++)
+        for(int x = 0; x < width; x++)
+            blend(rgb + (size_t(y) * width + x) * 3,
+                  heatColor(double(cost[(y / tiles::TileSize) * columns + x / tiles::TileSize]) / dearest));
+}
+
+} // namespace debugview
+
+#endif // DEBUG_VIEW_GUARD
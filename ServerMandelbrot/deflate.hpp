@@ -0,0 +1,206 @@
+#ifndef DEFLATE_GUARD
+#define DEFLATE_GUARD
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Deflate (RFC 1951) compression in independent chunks. Every chunk is LZ77
+// matched within itself, Huffman coded with the fixed code and closed with an
+// empty stored block so that it ends on a byte boundary. Such chunks can be
+// compressed in parallel and simply concatenated into one stream, at the cost
+// of matches never reaching back into the previous chunk.
+namespace deflate{
+
+const size_t ChunkSize = 256 << 10;
+
+class BitWriter{
+public:
+    explicit BitWriter(std::vector<unsigned char> &out) : out(out){}
+
+    // count bits of value, least significant first
+    void put(uint32_t value, int count){
+        buffer |= uint64_t(value) << bits;
+        bits += count;
+        while(bits >= 8){
+            out.push_back(buffer & 0xff);
+            buffer >>= 8;
+            bits -= 8;
+        }
+    }
+
+    // Huffman codes are sent most significant bit first
+    void putCode(uint32_t code, int length){
+        uint32_t reversed = 0;
+        for(int i = 0; i < length; i++)
+            reversed |= ((code >> i) & 1) << (length - 1 - i);
+        put(reversed, length);
+    }
+
+    void alignToByte(){
+        if(bits > 0)
+            put(0, 8 - bits);
+    }
+
+private:
+    std::vector<unsigned char> &out;
+    uint64_t buffer = 0;
+    int bits = 0;
+};
+
+inline void putLiteral(BitWriter &writer, int symbol){
+    if(symbol < 144)
+        writer.putCode(0x30 + symbol, 8);
+    else if(symbol < 256)
+        writer.putCode(0x190 + symbol - 144, 9);
+    else if(symbol < 280)
+        writer.putCode(symbol - 256, 7);
+    else
+        writer.putCode(0xc0 + symbol - 280, 8);
+}
+
+inline void putMatch(BitWriter &writer, int length, int distance){
+    static const int lengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+                                     67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const int lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                      4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const int distanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                       513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static const int distanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8,
+                                        9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    int code = 28;
+    while(lengthBase[code] > length)
+        code--;
+    putLiteral(writer, 257 + code);
+    writer.put(length - lengthBase[code], lengthExtra[code]);
+    code = 29;
+    while(distanceBase[code] > distance)
+        code--;
+    writer.putCode(code, 5);
+    writer.put(distance - distanceBase[code], distanceExtra[code]);
+}
+
+// Stored blocks, the fallback for data that does not compress.
+inline void storeChunk(const unsigned char *data, size_t size, std::vector<unsigned char> &out){
+    for(size_t offset = 0; offset < size; offset += 65535){
+        size_t length = std::min<size_t>(65535, size - offset);
+        out.push_back(0);
+        out.push_back(length & 0xff);
+        out.push_back(length >> 8);
+        out.push_back(~length & 0xff);
+        out.push_back((~length >> 8) & 0xff);
+        out.insert(out.end(), data + offset, data + offset + length);
+    }
+}
+
+// One chunk as non-final blocks ending on a byte boundary.
+inline std::vector<unsigned char> compressChunk(const unsigned char *data, size_t size){
+    const int WindowSize = 1 << 15;
+    const int HashBits = 15;
+    const int MaxChain = 32;
+    const int MinMatch = 3;
+    const int MaxMatch = 258;
+
+    std::vector<unsigned char> out;
+    out.reserve(size / 4 + 64);
+    BitWriter writer(out);
+    writer.put(0, 1); // not the final block
+    writer.put(1, 2); // fixed Huffman codes
+
+    std::vector<int32_t> head(1 << HashBits, -1);
+    std::vector<int32_t> previous(WindowSize, -1);
+    auto hash = [data](size_t position){
+        uint32_t value = data[position] | data[position + 1] << 8 | data[position + 2] << 16;
+        return (value * 2654435761u) >> (32 - HashBits);
+    };
+    auto insert = [&](size_t position){
+        uint32_t key = hash(position);
+        previous[position & (WindowSize - 1)] = head[key];
+        head[key] = int32_t(position);
+    };
+
+    size_t position = 0;
+    while(position < size){
+        int bestLength = 0;
+        int bestDistance = 0;
+        if(position + MinMatch <= size){
+            int limit = int(std::min<size_t>(MaxMatch, size - position));
+            int32_t candidate = head[hash(position)];
+            for(int chain = 0; candidate >= 0 && chain < MaxChain; chain++){
+                int distance = int(position - candidate);
+                if(distance > WindowSize)
+                    break;
+                int length = 0;
+                while(length < limit && data[candidate + length] == data[position + length])
+                    length++;
+                if(length > bestLength){
+                    bestLength = length;
+                    bestDistance = distance;
+                    if(length == limit)
+                        break;
+                }
+                candidate = previous[candidate & (WindowSize - 1)];
+            }
+        }
+        if(bestLength >= MinMatch){
+            putMatch(writer, bestLength, bestDistance);
+            for(int i = 0; i < bestLength; i++, position++)
+                if(position + MinMatch <= size)
+                    insert(position);
+        } else{
+            putLiteral(writer, data[position]);
+            if(position + MinMatch <= size)
+                insert(position);
+            position++;
+        }
+    }
+    putLiteral(writer, 256); // end of block
+
+    // empty stored block to end on a byte boundary
+    writer.put(0, 3);
+    writer.alignToByte();
+    out.insert(out.end(), {0, 0, 0xff, 0xff});
+
+    if(out.size() > size + size / 65535 * 5 + 5){
+        out.clear();
+        storeChunk(data, size, out);
+    }
+    return out;
+}
+
+// Deflate blocks of all the data, none of them final, compressed by up to
+// threads threads. No threads means stored blocks only.
+inline std::vector<unsigned char> compress(const unsigned char *data, size_t size, int threads){
+    std::vector<unsigned char> out;
+    if(threads <= 0){
+        storeChunk(data, size, out);
+        return out;
+    }
+    const size_t chunkCount = (size + ChunkSize - 1) / ChunkSize;
+    std::vector<std::vector<unsigned char>> chunks(chunkCount);
+    std::atomic<size_t> next(0);
+    auto work = [&](){
+        for(size_t chunk = next++; chunk < chunkCount; chunk = next++)
+            chunks[chunk] = compressChunk(data + chunk * ChunkSize, std::min(ChunkSize, size - chunk * ChunkSize));
+    };
+    std::vector<std::thread> pool;
+    for(size_t thread = 1; thread < std::min<size_t>(threads, chunkCount); thread++)
+        pool.emplace_back(work);
+    work();
+    for(std::thread &thread : pool)
+        thread.join();
+
+    size_t total = 0;
+    for(const auto &chunk : chunks)
+        total += chunk.size();
+    out.reserve(total);
+    for(const auto &chunk : chunks)
+        out.insert(out.end(), chunk.begin(), chunk.end());
+    return out;
+}
+
+} // namespace deflate
+
+#endif // DEFLATE_GUARD
@@ -0,0 +1,313 @@
+#ifndef ENGINE_GUARD
+#define ENGINE_GUARD
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+#include "mandelbrot.hpp"
+#include "metrics.hpp"
+#include "perf_counters.hpp"
+#include "trace.hpp"
+
+namespace engine{
+
+enum class Mapping : int{
+    // Pixel (column, row) lies at (originX + (x + column) * stepX, originY - (y + row) * stepY).
+    Linear,
+    // Columns are angles and rows are radii shrinking exponentially around (originX, originY):
+    // pixel (column, row) lies at angle (x + column) * stepX and
+    // distance radius * exp(-(y + row) * stepY) from the center.
+    LogPolar,
+};
+
+// Rectangular block of pixels sampled on a regular grid of the complex plane.
+struct Job{
+    double originX;
+    double originY;
+    double stepX;
+    double stepY;
+    int64_t x;
+    int64_t y;
+    int64_t width;
+    int64_t height;
+    int maxIterations;
+    Mapping mapping;
+    double radius;
+};
+
+inline Job viewportJob(const Viewport &viewport, int maxIterations){
+    return Job{viewport.leftTopX, viewport.leftTopY, viewport.stepX(), viewport.stepY(),
+               0, 0, viewport.width, viewport.height, maxIterations, Mapping::Linear, 0};
+}
+
+inline int64_t pixelCount(const std::vector<Job> &jobs){
+    int64_t pixels = 0;
+    for(const Job &job : jobs)
+        pixels += job.width * job.height;
+    return pixels;
+}
+
+// Rows of all jobs laid back to back, and the pixels they hold, handed to one rank.
+struct Slice{
+    int64_t rowBegin;
+    int64_t rowEnd;
+    int64_t pixelBegin;
+    int64_t pixelEnd;
+};
+
+// Splits the rows of all jobs between the computing ranks so that each gets
+// roughly the same number of pixels. Rows stay contiguous, so every rank
+// produces one contiguous part of the result.
+inline std::vector<Slice> partition(const std::vector<Job> &jobs, int workers){
+    int64_t totalPixels = pixelCount(jobs);
+    std::vector<Slice> slices(workers, Slice{0, 0, 0, 0});
+    int worker = 0;
+    int64_t row = 0;
+    int64_t pixels = 0;
+    for(const Job &job : jobs){
+        for(int64_t y = 0; y < job.height; y++){
+            while(worker < workers - 1 && pixels >= totalPixels * (worker + 1) / workers){
+                slices[worker].rowEnd = row;
+                slices[worker].pixelEnd = pixels;
+                worker++;
+                slices[worker].rowBegin = row;
+                slices[worker].pixelBegin = pixels;
+            }
+            row++;
+            pixels += job.width;
+        }
+    }
+    slices[worker].rowEnd = row;
+    slices[worker].pixelEnd = pixels;
+    for(worker++; worker < workers; worker++)
+        slices[worker] = Slice{row, row, pixels, pixels};
+    return slices;
+}
+
+// Iteration counts of the pixels in the slice, written to out row after row.
+inline uint64_t computeSlice(const std::vector<Job> &jobs, const Slice &slice, uint32_t *out){
+    uint64_t iterations = 0;
+    int64_t firstRow = 0;
+    for(const Job &job : jobs){
+        int64_t from = std::max(slice.rowBegin - firstRow, int64_t(0));
+        int64_t to = std::min(slice.rowEnd - firstRow, job.height);
+        for(int64_t row = from; row < to && job.mapping == Mapping::Linear; row++){
+            double y = job.originY - (job.y + row) * job.stepY;
+            for(int64_t column = 0; column < job.width; column++){
+                double x = job.originX + (job.x + column) * job.stepX;
+                *out = inMandelbrot(x, y, job.maxIterations);
+                iterations += *out++;
+            }
+        }
+        for(int64_t row = from; row < to && job.mapping == Mapping::LogPolar; row++){
+            double radius = job.radius * std::exp(-(job.y + row) * job.stepY);
+            for(int64_t column = 0; column < job.width; column++){
+                double angle = (job.x + column) * job.stepX;
+                *out = inMandelbrot(job.originX + radius * std::cos(angle),
+                                    job.originY + radius * std::sin(angle), job.maxIterations);
+                iterations += *out++;
+            }
+        }
+        firstRow += job.height;
+    }
+    return iterations;
+}
+
+// Spreads lists of jobs over the ranks. Rank 0 is the coordinator: it builds
+// the jobs and gathers the results, while every other rank runs serve().
+// With a single rank the coordinator computes everything itself.
+class Engine{
+public:
+    // Rank 0 only. Returns the iteration counts of every pixel, job after job,
+    // row after row.
+    std::vector<uint32_t> compute(const std::vector<Job> &jobs){
+        submit(jobs);
+        return collect();
+    }
+
+    // Rank 0 only. Sends the jobs to the workers and returns while they compute,
+    // so rank 0 can do other work until collect(). The jobs travel by value into
+    // every worker's inbox, so the workers start on them without rank 0 making
+    // progress in between.
+    void submit(const std::vector<Job> &jobs){
+        trace::Scope scope("broadcast", int64_t(jobs.size()));
+        pending.reset(new Pending{jobs});
+        for(int rank = 1; rank < upcxx::rank_n(); rank++)
+            upcxx::rpc_ff(rank, [](const std::vector<Job> &jobs){ inbox().push_back(JobList{jobs, false}); }, jobs);
+        // put the messages on the wire now rather than at the next barrier
+        upcxx::progress(upcxx::progress_level::internal);
+    }
+
+    // Rank 0 only. Waits for the jobs of the last submit() and returns their results.
+    std::vector<uint32_t> collect(){
+        const std::vector<Job> &jobs = pending->jobs;
+        work.rankSeconds.resize(upcxx::rank_n());
+        std::vector<Slice> slices = partition(jobs, workers());
+        std::vector<uint32_t> result(pixelCount(jobs));
+        auto begin_time = std::chrono::steady_clock::now();
+        if(upcxx::rank_n() == 1){
+            trace::Scope scope("compute", int64_t(result.size()));
+            counters::Measure measure(counters::Compute);
+            metrics::Timer timer(metrics::Compute);
+            uint64_t iterations = computeSlice(jobs, slices[0], result.data());
+            metrics::Registry::instance().computed(int64_t(result.size()), iterations, timer.seconds());
+            work.rankSeconds[0] += timer.seconds();
+            work.iterations += iterations;
+        }
+
+        upcxx::dist_object<Computed> computed(Computed{nullptr, 0, 0});
+        {
+            trace::Scope scope("wait for workers");
+            upcxx::barrier();
+        }
+        auto computed_time = std::chrono::steady_clock::now();
+        {
+            trace::Scope scope("gather", int64_t(result.size()));
+            counters::Measure measure(counters::Gather);
+            metrics::Timer timer(metrics::Gather);
+            upcxx::future<> gathered = upcxx::make_future();
+            for(int rank = 1; rank < upcxx::rank_n(); rank++){
+                const Slice &slice = slices[rank - 1];
+                if(slice.pixelEnd == slice.pixelBegin)
+                    continue;
+                uint32_t *destination = result.data() + slice.pixelBegin;
+                size_t count = slice.pixelEnd - slice.pixelBegin;
+                double issued = trace::now();
+                Work *work = &this->work;
+                gathered = upcxx::when_all(gathered, computed.fetch(rank).then(
+                        [destination, count, issued, rank, work](const Computed &slice){
+                            work->rankSeconds[rank] += slice.seconds;
+                            work->iterations += slice.iterations;
+                            return upcxx::rget(slice.block, destination, count).then([issued, rank](){
+                                trace::complete("gather from rank", issued, rank);
+                            });
+                        }));
+            }
+            gathered.wait();
+            // the workers may free their blocks once everything is gathered
+            upcxx::barrier();
+        }
+        pending.reset();
+        phases.computeSeconds += std::chrono::duration<double>(computed_time - begin_time).count();
+        auto gathered_time = std::chrono::steady_clock::now();
+        phases.gatherSeconds += std::chrono::duration<double>(gathered_time - computed_time).count();
+        phases.pixels += result.size();
+        return result;
+    }
+
+    // Time rank 0 spent in collect(), summed over all calls.
+    struct Phases{
+        // waiting for the workers, or computing itself when it is alone
+        double computeSeconds = 0;
+        // fetching the results of the workers
+        double gatherSeconds = 0;
+        int64_t pixels = 0;
+    };
+
+    const Phases &timings() const{ return phases; }
+
+    // Compute time of every rank, rank 0 only counting when it is alone, and
+    // the iterations they computed.
+    struct Work{
+        std::vector<double> rankSeconds;
+        uint64_t iterations = 0;
+    };
+
+    // Rank 0 only. The work of all collect() calls since the last takeWork().
+    Work takeWork(){
+        Work taken = work;
+        taken.rankSeconds.resize(upcxx::rank_n());
+        work = Work();
+        return taken;
+    }
+
+    static int workers(){
+        return upcxx::rank_n() > 1 ? upcxx::rank_n() - 1 : 1;
+    }
+
+    // Rank 0 only. Lets the workers return from serve().
+    void stop(){
+        for(int rank = 1; rank < upcxx::rank_n(); rank++)
+            upcxx::rpc_ff(rank, [](){ inbox().push_back(JobList{{}, true}); });
+        upcxx::progress(upcxx::progress_level::internal);
+    }
+
+    // Every rank but 0. Computes the jobs rank 0 sends until it calls stop().
+    void serve(){
+        while(true){
+            JobList list;
+            {
+                trace::Scope scope("wait for jobs");
+                while(inbox().empty())
+                    upcxx::progress();
+                list = std::move(inbox().front());
+                inbox().pop_front();
+            }
+            if(list.stop)
+                return;
+            const std::vector<Job> &jobs = list.jobs;
+
+            Slice slice = partition(jobs, workers())[upcxx::rank_me() - 1];
+            upcxx::global_ptr<uint32_t> block = upcxx::new_array<uint32_t>(
+                    std::max<int64_t>(slice.pixelEnd - slice.pixelBegin, 1));
+            uint64_t iterations;
+            double seconds;
+            {
+                trace::Scope scope("compute", slice.pixelEnd - slice.pixelBegin);
+                counters::Measure measure(counters::Compute);
+                metrics::Timer timer(metrics::Compute);
+                iterations = computeSlice(jobs, slice, block.local());
+                seconds = timer.seconds();
+                metrics::Registry::instance().computed(slice.pixelEnd - slice.pixelBegin, iterations, seconds);
+            }
+
+            upcxx::dist_object<Computed> computed(Computed{block, seconds, iterations});
+            {
+                trace::Scope scope("wait for gather");
+                counters::Measure measure(counters::Gather);
+                upcxx::barrier();
+                upcxx::barrier();
+            }
+            upcxx::delete_array(block);
+        }
+    }
+
+private:
+    struct JobList{
+        std::vector<Job> jobs;
+        bool stop;
+    };
+
+    // Every rank but 0. Jobs sent to this rank that it has not started on yet,
+    // filled by the RPCs of submit() and stop() during progress.
+    static std::deque<JobList> &inbox(){
+        static std::deque<JobList> lists;
+        return lists;
+    }
+
+    // A worker's pixels of the current jobs and what they cost.
+    struct Computed{
+        upcxx::global_ptr<uint32_t> block;
+        double seconds;
+        uint64_t iterations;
+    };
+
+    // Jobs submitted but not collected yet.
+    struct Pending{
+        std::vector<Job> jobs;
+    };
+
+    std::unique_ptr<Pending> pending;
+    Phases phases;
+    Work work;
+};
+
+} // namespace engine
+
+#endif // ENGINE_GUARD
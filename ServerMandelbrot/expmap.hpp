@@ -0,0 +1,149 @@
+#ifndef EXPMAP_GUARD
+#define EXPMAP_GUARD
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "animation.hpp"
+#include "checkpoint.hpp"
+#include "colors.hpp"
+#include "engine.hpp"
+#include "image_writer.hpp"
+#include "logger.hpp"
+#include "options.hpp"
+
+// Zoom videos from an exponential map: one log-polar strip around the zoom
+// center covers every scale of the zoom, so it is computed once and each
+// frame is resampled from it instead of being rendered on its own.
+namespace expmap{
+
+struct Strip{
+    double centerX;
+    double centerY;
+    double outerRadius;
+    double innerRadius;
+    // angle and log radius step, the same so that strip pixels are square
+    double step;
+    int64_t columns;
+    int64_t rows;
+    int iterations;
+    std::vector<uint32_t> counters;
+};
+
+// Strip covering the corners of the first frame down to half a pixel of the last one.
+// Its angular resolution matches the frame's pixels at the frame's edge.
+inline Strip planStrip(const Options &options){
+    const Viewport &from = options.view;
+    const Viewport &to = options.endView;
+    Strip strip;
+    strip.centerX = (to.leftTopX + to.rightBottomX) / 2;
+    strip.centerY = (to.leftTopY + to.rightBottomY) / 2;
+    double fromWidth = from.rightBottomX - from.leftTopX;
+    double fromHeight = from.leftTopY - from.rightBottomY;
+    strip.outerRadius = std::sqrt(fromWidth * fromWidth + fromHeight * fromHeight) / 2;
+    strip.innerRadius = std::min(to.stepX(), to.stepY()) / 2;
+    strip.columns = int64_t(std::ceil(M_PI * std::max(from.width, from.height)));
+    strip.step = 2 * M_PI / strip.columns;
+    strip.rows = int64_t(std::ceil(std::log(strip.outerRadius / strip.innerRadius) / strip.step)) + 1;
+    strip.iterations = options.iterations > 0 ? options.iterations : iterationCap(to);
+    return strip;
+}
+
+// Frame of the given size around the strip's center, resampled from the strip.
+inline void resample(const Strip &strip, const Viewport &frame, std::vector<uint32_t> &counters){
+    counters.resize(size_t(frame.width) * frame.height);
+    const double logOuter = std::log(strip.outerRadius);
+    const double stepX = frame.stepX();
+    const double stepY = frame.stepY();
+    for(int y = 0; y < frame.height; y++){
+        double dy = frame.leftTopY - y * stepY - strip.centerY;
+        for(int x = 0; x < frame.width; x++){
+            double dx = frame.leftTopX + x * stepX - strip.centerX;
+            double radius = std::sqrt(dx * dx + dy * dy);
+            int64_t row = strip.rows - 1;
+            if(radius > strip.innerRadius)
+                row = std::min<int64_t>(std::max<int64_t>(std::llround((logOuter - std::log(radius)) / strip.step), 0),
+                                        strip.rows - 1);
+            double angle = std::atan2(dy, dx);
+            if(angle < 0)
+                angle += 2 * M_PI;
+            int64_t column = std::llround(angle / strip.step) % strip.columns;
+            counters[size_t(y) * frame.width + x] = strip.counters[row * strip.columns + column];
+        }
+    }
+}
+
+// Renders the zoom animation of the options through one strip. Rank 0 only.
+// The first view is moved to the center of the last one, the zoom has a fixed center.
+// With checkpoints the strip is saved once to OUTPUT.strip as soon as it is
+// computed, and the checkpoint itself only holds the number of frames written.
+inline void render(engine::Engine &engine, const Options &options){
+    animation::framePath(options.outputPath, 0);
+    auto begin_time = std::chrono::steady_clock::now();
+    Strip strip = planStrip(options);
+    checkpoint::Checkpoint saved(options.outputPath + ".strip", animation::describe("expmap strip", options),
+                                 options.checkpointSeconds);
+    checkpoint::Checkpoint progress(options.outputPath + ".checkpoint", animation::describe("expmap frames", options),
+                                    options.checkpointSeconds);
+    LOG(Info) << "Server: // ExpMap   // Strip of " << strip.columns << "x" << strip.rows << " pixels, "
+              << strip.iterations << " iterations";
+    std::string savedCounters = saved.resuming() ? saved.restored().getBytes() : std::string();
+    if(savedCounters.size() == size_t(strip.columns * strip.rows) * sizeof(uint32_t)){
+        strip.counters.resize(size_t(strip.columns * strip.rows));
+        std::memcpy(strip.counters.data(), savedCounters.data(), savedCounters.size());
+        LOG(Info) << "Server: // Resume   // Using the strip saved in " << options.outputPath << ".strip";
+    } else{
+        strip.counters = engine.compute({engine::Job{strip.centerX, strip.centerY, strip.step, strip.step,
+                                                     0, 0, strip.columns, strip.rows, strip.iterations,
+                                                     engine::Mapping::LogPolar, strip.outerRadius}});
+        std::chrono::duration<double> computed = std::chrono::steady_clock::now() - begin_time;
+        LOG(Info) << "Server: // ExpMap   // Calculations took " << computed.count() << " seconds.";
+        checkpoint::Record record;
+        record.putBytes(strip.counters.data(), strip.counters.size() * sizeof(uint32_t));
+        saved.save(record);
+    }
+    savedCounters = std::string();
+    int startFrame = progress.resuming() ? progress.restored().get<int>() : 0;
+    if(startFrame > 0)
+        LOG(Info) << "Server: // Resume   // Carrying on from frame " << startFrame;
+
+    const Viewport &from = options.view;
+    const Viewport &to = options.endView;
+    double fromWidth = from.rightBottomX - from.leftTopX;
+    double fromHeight = from.leftTopY - from.rightBottomY;
+    double toWidth = to.rightBottomX - to.leftTopX;
+    double toHeight = to.leftTopY - to.rightBottomY;
+    colors::Palette palette(strip.iterations);
+    std::vector<uint32_t> counters;
+    std::vector<char> rgb(size_t(from.width) * from.height * 3);
+    for(int frame = startFrame; frame < options.frames; frame++){
+        if(progress.due()){
+            checkpoint::Record record;
+            record.put(frame);
+            progress.save(record);
+        }
+        double t = animation::ease(options.easing, options.frames > 1 ? double(frame) / (options.frames - 1) : 0);
+        double width = fromWidth * std::pow(toWidth / fromWidth, t);
+        double height = fromHeight * std::pow(toHeight / fromHeight, t);
+        Viewport view{from.width, from.height,
+                      strip.centerX - width / 2, strip.centerY + height / 2,
+                      strip.centerX + width / 2, strip.centerY - height / 2};
+        resample(strip, view, counters);
+        palette.paint(counters.data(), counters.size(), rgb.data());
+        std::unique_ptr<image::ImageWriter> writer =
+                image::openImage(animation::framePath(options.outputPath, frame), view.width, view.height);
+        writer->writeRows(rgb.data(), view.height);
+        writer->finish();
+    }
+    progress.remove();
+    saved.remove();
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - begin_time;
+    LOG(Info) << "Server: // ExpMap   // " << options.frames - startFrame << " frames took " << diff.count()
+              << " seconds (" << (options.frames - startFrame) / diff.count() << " frames/s)";
+}
+
+} // namespace expmap
+
+#endif // EXPMAP_GUARD
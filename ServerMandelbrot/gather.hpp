@@ -0,0 +1,41 @@
+#ifndef GATHER_GUARD
+#define GATHER_GUARD
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+// Collective: every rank hands in a list of trivially copyable items and
+// rank 0 gets all lists back, indexed by rank. Other ranks get nothing.
+template<typename T>
+std::vector<std::vector<T>> gatherToRoot(const std::vector<T> &items){
+    struct Shared{
+        upcxx::global_ptr<T> items;
+        int64_t count;
+    };
+    upcxx::global_ptr<T> block = upcxx::new_array<T>(std::max<size_t>(items.size(), 1));
+    std::copy(items.begin(), items.end(), block.local());
+    upcxx::dist_object<Shared> shared(Shared{block, int64_t(items.size())});
+    // every rank has published its list
+    upcxx::barrier();
+
+    std::vector<std::vector<T>> gathered;
+    if(upcxx::rank_me() == 0){
+        gathered.resize(upcxx::rank_n());
+        gathered[0] = items;
+        for(int rank = 1; rank < upcxx::rank_n(); rank++){
+            Shared remote = shared.fetch(rank).wait();
+            gathered[rank].resize(remote.count);
+            if(remote.count > 0)
+                upcxx::rget(remote.items, gathered[rank].data(), remote.count).wait();
+        }
+    }
+    // rank 0 is done reading
+    upcxx::barrier();
+    upcxx::delete_array(block);
+    return gathered;
+}
+
+#endif // GATHER_GUARD
@@ -0,0 +1,240 @@
+#ifndef IMAGE_WRITER_GUARD
+#define IMAGE_WRITER_GUARD
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "deflate.hpp"
+#include "logger.hpp"
+
+namespace image{
+
+struct CrcTable{
+    CrcTable(){
+        for(uint32_t n = 0; n < 256; n++){
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+    }
+
+    uint32_t entries[256];
+};
+
+// Any thread, PNG files may be written side by side.
+inline uint32_t crc32(uint32_t crc, const unsigned char *bytes, size_t size){
+    static const CrcTable crcTable;
+    const uint32_t *table = crcTable.entries;
+    crc = ~crc;
+    for(size_t i = 0; i < size; i++)
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline uint32_t adler32(uint32_t adler, const unsigned char *bytes, size_t size){
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while(size > 0){
+        // 5552 bytes is the most that can be summed before the sums may overflow
+        size_t block = size < 5552 ? size : 5552;
+        for(size_t i = 0; i < block; i++){
+            a += bytes[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        bytes += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+// How far a writer got, enough to reopen the file and carry on writing it.
+struct WriterState{
+    uint64_t offset;
+    uint32_t adler;
+};
+
+// Writes an RGB image to a file top to bottom, a band of rows at a time,
+// so that images larger than memory can be streamed out.
+class ImageWriter{
+public:
+    virtual ~ImageWriter(){
+        if(file)
+            std::fclose(file);
+    }
+
+    // rows * width pixels, three bytes each.
+    virtual void writeRows(const char *rgb, uint32_t rows) = 0;
+
+    // Flushes everything written so far to disk and tells how far that is.
+    virtual WriterState state(){
+        if(std::fflush(file) != 0 || fsync(fileno(file)) != 0)
+            fail();
+        return WriterState{uint64_t(ftello(file)), 0};
+    }
+
+    // Has to be called once all height rows have been written.
+    virtual void finish(){
+        if(file && std::fclose(file) != 0)
+            fail();
+        file = nullptr;
+    }
+
+protected:
+    // Starts a new file, or carries on from the state of an earlier writer.
+    ImageWriter(const std::string &path, uint32_t width, uint32_t height, const WriterState *resume)
+            : path(path), width(width), height(height){
+        file = std::fopen(path.c_str(), resume ? "r+b" : "wb");
+        if(!file)
+            fail();
+        if(resume && (ftruncate(fileno(file), off_t(resume->offset)) != 0 ||
+                      fseeko(file, off_t(resume->offset), SEEK_SET) != 0))
+            fail();
+    }
+
+    void put(const void *bytes, size_t size){
+        if(std::fwrite(bytes, 1, size, file) != size)
+            fail();
+    }
+
+    void fail(){
+        LOG(Error) << "Server: // Image    // Writing " << path << " failed. Errno: " << errno;
+        throw -1;
+    }
+
+    std::string path;
+    uint32_t width;
+    uint32_t height;
+    std::FILE *file;
+};
+
+// Binary portable pixmap.
+class PpmWriter : public ImageWriter{
+public:
+    PpmWriter(const std::string &path, uint32_t width, uint32_t height, const WriterState *resume)
+            : ImageWriter(path, width, height, resume){
+        if(resume)
+            return;
+        std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        put(header.data(), header.size());
+    }
+
+    void writeRows(const char *rgb, uint32_t rows) override{
+        put(rgb, size_t(rows) * width * 3);
+    }
+};
+
+// Threads compressing PNG data, 0 stores it uncompressed.
+inline int &compressionThreads(){
+    static int threads = std::max(1u, std::thread::hardware_concurrency());
+    return threads;
+}
+
+// 8 bit RGB PNG. Every band of rows is compressed in parallel chunks by
+// deflate::compress() and becomes as many IDAT chunks as its length needs.
+class PngWriter : public ImageWriter{
+public:
+    PngWriter(const std::string &path, uint32_t width, uint32_t height, const WriterState *resume)
+            : ImageWriter(path, width, height, resume){
+        if(resume){
+            adler = resume->adler;
+            return;
+        }
+        static const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        put(signature, sizeof(signature));
+        std::vector<unsigned char> header;
+        bigEndian(header, width);
+        bigEndian(header, height);
+        // bit depth 8, color type RGB, deflate, adaptive filtering, no interlace
+        header.insert(header.end(), {8, 2, 0, 0, 0});
+        chunk("IHDR", header);
+        // zlib header of a deflate stream with a 32K window
+        chunk("IDAT", {0x78, 0x01});
+    }
+
+    void writeRows(const char *rgb, uint32_t rows) override{
+        std::vector<unsigned char> scanlines;
+        scanlines.reserve(size_t(rows) * (width * 3 + 1));
+        for(uint32_t row = 0; row < rows; row++){
+            // filter type None
+            scanlines.push_back(0);
+            const unsigned char *line = reinterpret_cast<const unsigned char *>(rgb) + size_t(row) * width * 3;
+            scanlines.insert(scanlines.end(), line, line + size_t(width) * 3);
+        }
+        adler = adler32(adler, scanlines.data(), scanlines.size());
+
+        std::vector<unsigned char> blocks = deflate::compress(scanlines.data(), scanlines.size(),
+                                                              compressionThreads());
+        for(size_t offset = 0; offset < blocks.size(); offset += MaxChunkBytes)
+            chunk("IDAT", blocks.data() + offset, std::min(size_t(MaxChunkBytes), blocks.size() - offset));
+    }
+
+    WriterState state() override{
+        WriterState written = ImageWriter::state();
+        written.adler = adler;
+        return written;
+    }
+
+    void finish() override{
+        // final empty stored block, then the checksum of the uncompressed data
+        std::vector<unsigned char> end = {1, 0, 0, 0xff, 0xff};
+        bigEndian(end, adler);
+        chunk("IDAT", end);
+        chunk("IEND", {});
+        ImageWriter::finish();
+    }
+
+protected:
+    // Chunk lengths have to fit in 31 bits.
+    static const size_t MaxChunkBytes = 0x7fffffff;
+
+    static void bigEndian(std::vector<unsigned char> &bytes, uint32_t value){
+        bytes.push_back(value >> 24);
+        bytes.push_back(value >> 16);
+        bytes.push_back(value >> 8);
+        bytes.push_back(value);
+    }
+
+    void chunk(const char *type, const unsigned char *data, size_t size){
+        std::vector<unsigned char> head;
+        bigEndian(head, uint32_t(size));
+        head.insert(head.end(), type, type + 4);
+        std::vector<unsigned char> tail;
+        bigEndian(tail, crc32(crc32(0, head.data() + 4, 4), data, size));
+        put(head.data(), head.size());
+        put(data, size);
+        put(tail.data(), tail.size());
+    }
+
+    void chunk(const char *type, const std::vector<unsigned char> &data){
+        chunk(type, data.data(), data.size());
+    }
+
+    uint32_t adler = 1;
+};
+
+inline bool endsWith(const std::string &text, const std::string &suffix){
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// PNG for paths ending in .png, PPM otherwise. With a state the file is
+// reopened where an earlier writer of the same image left it.
+inline std::unique_ptr<ImageWriter> openImage(const std::string &path, uint32_t width, uint32_t height,
+                                              const WriterState *resume = nullptr){
+    if(endsWith(path, ".png") || endsWith(path, ".PNG"))
+        return std::unique_ptr<ImageWriter>(new PngWriter(path, width, height, resume));
+    return std::unique_ptr<ImageWriter>(new PpmWriter(path, width, height, resume));
+}
+
+} // namespace image
+
+#endif // IMAGE_WRITER_GUARD
@@ -0,0 +1,227 @@
+#ifndef LOGGER_GUARD
+#define LOGGER_GUARD
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Leveled logging that keeps terminal I/O off the calling thread. LOG(level)
+// formats a line only when the level is enabled and puts it in a lock-free
+// ring, which a background thread writes to stdout in batches. Errors are
+// written before LOG returns, as they are usually followed by throw -1, and
+// whatever is still in the ring is written when that throw ends in terminate.
+// The client shares this header with the server.
+//
+//     LOG(Info) << "Server: // Batch    // Wrote " << path;
+#define LOG(level) \
+    !logging::Logger::instance().enabled(logging::level) ? (void) 0 \
+                                                         : logging::Voidify() & logging::Line(logging::level)
+
+namespace logging{
+
+enum Level{
+    Error,
+    Warning,
+    Info,
+    // every request of the client, off by default
+    Debug,
+};
+
+// False for a name that is not a level.
+inline bool parseLevel(const std::string &name, Level &level){
+    const char *names[] = {"error", "warning", "info", "debug"};
+    for(int n = 0; n <= Debug; n++)
+        if(name == names[n]){
+            level = Level(n);
+            return true;
+        }
+    return false;
+}
+
+class Logger{
+public:
+    static Logger &instance(){
+        static Logger logger;
+        return logger;
+    }
+
+    ~Logger(){
+        stopping.store(true);
+        flusher.join();
+        flush();
+    }
+
+    bool enabled(Level level) const{ return level <= threshold.load(std::memory_order_relaxed); }
+
+    void setLevel(Level level){ threshold.store(level); }
+
+    // Prefix of the logger's own lines, "Server" unless set.
+    void setProgram(const std::string &name){
+        std::lock_guard<std::mutex> lock(draining);
+        program = name;
+    }
+
+    // Any thread. Drops the line when the ring is full, unless it is an error.
+    void push(Level level, const std::string &text){
+        while(!tryPush(text)){
+            if(level != Error){
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            flush();
+        }
+    }
+
+    // Writes every line pushed so far, on the calling thread.
+    void flush(){
+        std::lock_guard<std::mutex> lock(draining);
+        std::string batch;
+        Slot *slot;
+        while((slot = front())){
+            batch.append(slot->text, slot->length);
+            pop(slot);
+        }
+        size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if(lost > 0)
+            batch += program + ": // Log      // " + std::to_string(lost) + " lines dropped, the log ring was full\n";
+        if(!batch.empty()){
+            std::fwrite(batch.data(), 1, batch.size(), stdout);
+            std::fflush(stdout);
+        }
+    }
+
+private:
+    static const size_t SlotCount = 4096;
+    static const size_t LineBytes = 240;
+
+    struct Slot{
+        // position the slot is free for, plus one once it holds that position's line
+        std::atomic<size_t> sequence;
+        size_t length;
+        char text[LineBytes];
+    };
+
+    Logger() : slots(SlotCount){
+        for(size_t n = 0; n < SlotCount; n++)
+            slots[n].sequence.store(n, std::memory_order_relaxed);
+        flusher = std::thread([this](){ run(); });
+        previousTerminate() = std::set_terminate(onTerminate);
+    }
+
+    // Static destructors do not run on terminate, so the ring is written here.
+    static std::terminate_handler &previousTerminate(){
+        static std::terminate_handler handler = nullptr;
+        return handler;
+    }
+
+    static void onTerminate(){
+        instance().flush();
+        if(previousTerminate())
+            previousTerminate()();
+        std::abort();
+    }
+
+    // A bounded multi-producer queue: producers claim positions with a
+    // compare-and-swap and publish a slot by advancing its sequence.
+    bool tryPush(const std::string &text){
+        size_t position = enqueued.load(std::memory_order_relaxed);
+        Slot *slot;
+        while(true){
+            slot = &slots[position % SlotCount];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            if(sequence == position){
+                if(enqueued.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            } else if(sequence < position){
+                return false;
+            } else{
+                position = enqueued.load(std::memory_order_relaxed);
+            }
+        }
+        slot->length = std::min(text.size(), size_t(LineBytes));
+        std::memcpy(slot->text, text.data(), slot->length);
+        // a cut line still ends the line
+        slot->text[slot->length - 1] = '\n';
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only with draining held.
+    Slot *front(){
+        Slot *slot = &slots[dequeued % SlotCount];
+        return slot->sequence.load(std::memory_order_acquire) == dequeued + 1 ? slot : nullptr;
+    }
+
+    void pop(Slot *slot){
+        slot->sequence.store(dequeued + SlotCount, std::memory_order_release);
+        dequeued++;
+    }
+
+    // Sleeps longer the longer nothing is logged, up to 50 ms.
+    void run(){
+        std::chrono::milliseconds pause(1);
+        while(!stopping.load()){
+            size_t before = enqueued.load(std::memory_order_relaxed);
+            std::this_thread::sleep_for(pause);
+            bool busy = enqueued.load(std::memory_order_relaxed) != before;
+            flush();
+            pause = busy ? std::chrono::milliseconds(1) : std::min(pause * 2, std::chrono::milliseconds(50));
+        }
+    }
+
+    std::vector<Slot> slots;
+    std::atomic<size_t> enqueued{0};
+    size_t dequeued = 0;
+    std::mutex draining;
+    std::string program = "Server";
+    std::atomic<size_t> dropped{0};
+    std::atomic<int> threshold{Info};
+    std::atomic<bool> stopping{false};
+    std::thread flusher;
+};
+
+// One line, pushed to the logger when it goes out of scope.
+class Line{
+public:
+    explicit Line(Level level) : level(level){}
+
+    ~Line(){
+        stream << '\n';
+        Logger::instance().push(level, stream.str());
+        if(level == Error)
+            Logger::instance().flush();
+    }
+
+    template<typename T>
+    Line &operator<<(const T &value){
+        stream << value;
+        return *this;
+    }
+
+    Line(const Line &) = delete;
+
+    Line &operator=(const Line &) = delete;
+
+private:
+    Level level;
+    std::ostringstream stream;
+};
+
+// Turns a whole LOG line into void, so both branches of the ?: in LOG match.
+struct Voidify{
+    void operator&(const Line &){}
+};
+
+} // namespace logging
+
+#endif // LOGGER_GUARD
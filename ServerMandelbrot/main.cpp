@@ -3,172 +3,238 @@
  *
  * Copyright (c) 2019 AGH FiIS
  */
+#include <algorithm>
 #include <chrono>
-#include <iostream>
-#include <thread>
 #include <cmath>
+#include <memory>
 #include <vector>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
 #include <upcxx/upcxx.hpp>
+#include "animation.hpp"
+#include "batch.hpp"
 #include "colors.hpp"
+#include "debug_view.hpp"
+#include "engine.hpp"
+#include "expmap.hpp"
+#include "image_writer.hpp"
+#include "logger.hpp"
+#include "mandelbrot.hpp"
+#include "metrics.hpp"
+#include "options.hpp"
+#include "perf_counters.hpp"
+#include "protocol.hpp"
+#include "pyramid.hpp"
+#include "renderer.hpp"
+#include "scenes.hpp"
+#include "tile_store.hpp"
+#include "trace.hpp"
 
 int proc_id, num_procs;
 
-inline double rSq(double Re, double Im) {
-    return Re * Re + Im * Im;
-}
-
-unsigned int inMandelbrot(double x, double y, int max_iterations) {
-    int iteration = 0;
-    double Re = 0;
-    double Im = 0;
-    while (rSq(Re, Im) <= 4 && iteration < max_iterations) {
-        double Re_temp = Re * Re - Im * Im + x;
-        Im = 2 * Re * Im + y;
-        Re = Re_temp;
-        iteration++;
+// Cost of a frame from the work of its compute calls.
+FrameStats frameStats(const engine::Engine::Work &work, double seconds, int iterationCap) {
+    FrameStats stats = {seconds, int64_t(work.iterations), iterationCap, int(work.rankSeconds.size()), 0, 0};
+    size_t first = work.rankSeconds.size() > 1 ? 1 : 0;
+    double mean = 0;
+    double slowest = 0;
+    for (size_t rank = first; rank < work.rankSeconds.size(); rank++) {
+        mean += work.rankSeconds[rank];
+        slowest = std::max(slowest, work.rankSeconds[rank]);
     }
-    return iteration;
+    mean /= work.rankSeconds.size() - first;
+    if (mean <= 0)
+        return stats;
+    for (size_t rank = first; rank < work.rankSeconds.size(); rank++)
+        stats.meanImbalance += std::abs(work.rankSeconds[rank] - mean);
+    stats.meanImbalance /= (work.rankSeconds.size() - first) * mean;
+    stats.maxImbalance = slowest / mean - 1;
+    return stats;
 }
 
-struct Request {
-    bool connectionOk;
-    int windowWidth;
-    int windowHeight;
-    double leftTopX;
-    double leftTopY;
-    double rightBottomX;
-    double rightBottomY;
-};
-
-int main(int argc, char *argv[]) {
-    upcxx::init();
-
-    proc_id = upcxx::rank_me();
-    num_procs = upcxx::rank_n();
+// Answers the requests of the client until it disconnects. Rank 0 only.
+void serveClient(engine::Engine &engine, FrameRenderer &renderer) {
     std::string req = "/tmp/.req";
     std::string resp = "/tmp/.resp";
     int requestPipe;
     int responsePipe;
     std::chrono::time_point<std::chrono::steady_clock> begin_time;
 
-    upcxx::dist_object<upcxx::global_ptr<Request>> global_request(upcxx::new_<Request>());
+    mkfifo(req.c_str(), 0777);
+    mkfifo(resp.c_str(), 0777);
 
-//////////////////////////////////
-    if (proc_id == 0) {
-        mkfifo(req.c_str(), 0777);
-        mkfifo(resp.c_str(), 0777);
+    requestPipe = open(req.c_str(), O_RDONLY);
+    if (requestPipe == -1) {
+        throw -1;
+    }
+    responsePipe = open(resp.c_str(), O_WRONLY);
+    if (responsePipe == -1) {
+        throw -1;
+    }
 
-        requestPipe = open(req.c_str(), O_RDONLY);
-        if (requestPipe == -1) {
-            throw -1;
+    while (true) {
+        Request request;
+        std::vector<Region> regions;
+        std::vector<Viewport> viewports;
+        LOG(Debug) << "Server: // Request  // Reading request..";
+        bool received;
+        try {
+            trace::Scope scope("read request");
+            received = readFully(requestPipe, &request, sizeof(Request));
+            if (received && request.requestType == RegionRequest && request.regionCount > 0) {
+                regions.resize(request.regionCount);
+                received = readFully(requestPipe, regions.data(), regions.size() * sizeof(Region));
+            } else if (received && request.requestType == ViewportsRequest && request.regionCount > 0) {
+                viewports.resize(request.regionCount);
+                received = readFully(requestPipe, viewports.data(), viewports.size() * sizeof(Viewport));
+            }
+        } catch (int) {
+            LOG(Error) << "Server: // Request  // Reading request failed. Errno: " << errno;
+            throw;
         }
-        responsePipe = open(resp.c_str(), O_WRONLY);
-        if (responsePipe == -1) {
-            throw -1;
+        begin_time = std::chrono::steady_clock::now();
+        if (!received) {
+            LOG(Info) << "Server: // Request  // Client closed the pipe.";
+            break;
         }
-
-    }
-    bool connectionOK = true;
-    while (connectionOK) {
-        Request request;
-        int status;
-        if (proc_id == 0) {
-            std::cout << "Server: // Request  // Reading request.." << std::endl;
-            status = read(requestPipe, &request, sizeof(Request));
-            begin_time = std::chrono::steady_clock::now();
-            if (status == -1) {
-                std::cout << "Server: // Request  // Reading request failed. Errno: " << errno << std::endl;
-                throw -1;
+        LOG(Debug) << "Server: // Request  // Request read successfully. Diagnostics data:";
+        LOG(Debug) << "Server: // Request  // connectionOk: " << (request.connectionOk ? "yes" : "no");
+        LOG(Debug) << "Server: // Request  // windowHeight: " << request.windowHeight;
+        LOG(Debug) << "Server: // Request  // windowWidth:  " << request.windowWidth;
+        LOG(Debug) << "Server: // Request  // leftTopX:     " << request.leftTopX;
+        LOG(Debug) << "Server: // Request  // leftTopY:     " << request.leftTopY;
+        LOG(Debug) << "Server: // Request  // rightBottomX: " << request.rightBottomX;
+        LOG(Debug) << "Server: // Request  // rightBottomY: " << request.rightBottomY;
+        LOG(Debug) << "Server: // Request  // regions:      " << regions.size();
+        LOG(Debug) << "Server: // Request  // viewports:    " << viewports.size();
+        LOG(Debug) << "Server: // Request  // debugView:    " << request.debugView;
+        if (!request.connectionOk)
+            break;
+
+        metrics::Timer frameTimer(metrics::Frame);
+        Viewport viewport = requestViewport(request);
+        int iterations = iterationCap(viewport);
+        std::vector<uint32_t> rendered;
+        // Whole frames stay in the renderer for the next one to reuse, so they are not copied out of it.
+        const std::vector<uint32_t> *frame = &rendered;
+        std::vector<int> viewportIterations;
+        engine::Engine::Work work;
+        FrameStats stats;
+        {
+            trace::Scope scope("render", request.requestType);
+            metrics::Timer timer(metrics::Render);
+            if (request.requestType == ViewportsRequest) {
+                for (const Viewport &view : viewports)
+                    viewportIterations.push_back(iterationCap(view));
+                rendered = renderer.render(viewports, viewportIterations);
+            } else if (request.requestType == RegionRequest) {
+                for (Region &region : regions)
+                    region = clip(region, viewport);
+                rendered = renderer.render(viewport, iterations, regions);
+            } else if (request.debugView != NoDebugView) {
+                rendered = engine.compute({engine::viewportJob(viewport, iterations)});
+            } else {
+                frame = &renderer.render(viewport, iterations);
             }
-            std::cout << "Server: // Request  // Request read successfully. Diagnostics data:" << std::endl;
-            std::cout << "Server: // Request  // connectionOk: " << (request.connectionOk ? "yes" : "no") << std::endl;
-            std::cout << "Server: // Request  // windowHeight: " << request.windowHeight << std::endl;
-            std::cout << "Server: // Request  // windowWidth:  " << request.windowWidth << std::endl;
-            std::cout << "Server: // Request  // leftTopX:     " << request.leftTopX << std::endl;
-            std::cout << "Server: // Request  // leftTopY:     " << request.leftTopY << std::endl;
-            std::cout << "Server: // Request  // rightBottomX: " << request.rightBottomX << std::endl;
-            std::cout << "Server: // Request  // rightBottomY: " << request.rightBottomY << std::endl;
-            upcxx::rput(request, *global_request);
+            int iterationCap = viewportIterations.empty()
+                               ? iterations : *std::max_element(viewportIterations.begin(), viewportIterations.end());
+            work = engine.takeWork();
+            stats = frameStats(work, timer.seconds(), iterationCap);
         }
-        // wait for node 0 to receive the request
-        upcxx::barrier();
-        request = upcxx::rget(global_request.fetch(0).wait()).wait();
-
 
-        int width = request.windowWidth;
-        int height = request.windowHeight;
-        connectionOK = request.connectionOk;
-        if (!connectionOK)
-            continue;
-
-        // calculate number of lines to process by this thread
-        uint16_t linesForThread = 0;
-        if (proc_id == num_procs - 1) {
-            linesForThread = height - (num_procs - 2) * (height / (num_procs - 1));
-        } else {
-            linesForThread = height / (num_procs - 1);
+        const std::vector<uint32_t> &counters = *frame;
+        std::vector<char> result(counters.size() * 3);
+        {
+            trace::Scope scope("color", int64_t(counters.size()));
+            metrics::Timer timer(metrics::Color);
+            if (request.requestType == ViewportsRequest) {
+                size_t offset = 0;
+                for (size_t n = 0; n < viewports.size(); n++) {
+                    size_t pixels = size_t(std::max(viewports[n].width, 0)) * std::max(viewports[n].height, 0);
+                    colors::Palette(viewportIterations[n]).paint(counters.data() + offset, pixels,
+                                                                 result.data() + offset * 3);
+                    offset += pixels;
+                }
+            } else {
+                colors::Palette(iterations).paint(counters.data(), counters.size(), result.data());
+            }
+            if (request.requestType == FrameRequest && request.debugView == OwnershipView)
+                debugview::paintOwnership({engine::viewportJob(viewport, iterations)}, result.data());
+            else if (request.requestType == FrameRequest && request.debugView == CostView)
+                debugview::paintCost(counters, viewport.width, viewport.height, result.data());
         }
-        upcxx::dist_object<upcxx::global_ptr<char>> global_line(upcxx::new_array<char>(width * linesForThread * 3));
-
-        std::pair<double, double> start = {request.leftTopX, request.leftTopY};
-        std::pair<double, double> end = {request.rightBottomX, request.rightBottomY};
-        std::vector<char> result;
-        double surface = (end.first - start.first) * (start.second - end.second);
 
-        int iterations = 300 / sqrt(surface);
-        if (iterations > 2000)
-            iterations = 2000;
-        if (proc_id != 0) {
-            char *block_of_lines = global_line->local();
-            int y_from_picture_top = (height / (num_procs - 1)) * (proc_id - 1);
-            for (int y = 0;
-                 y < linesForThread; y++) {
-                for (int x = 0; x < width; x++) {
-                    double x_val = (1.0 * x / width) * (end.first - start.first) + start.first;
-                    double y_val =
-                            start.second - (1.0 * (y + y_from_picture_top) / height) * (start.second - end.second);
+        LOG(Debug) << "Server: // Response // Sending response..";
+        std::chrono::duration<double> diff = std::chrono::steady_clock::now() - begin_time;
+        LOG(Debug) << "Server: // Response // Calculations took " << (diff.count()) << " seconds.";
+        try {
+            trace::Scope scope("pipe write", int64_t(result.size()));
+            metrics::Timer timer(metrics::PipeWrite);
+            writeFully(responsePipe, result.data(), result.size());
+            writeFully(responsePipe, &stats, sizeof(FrameStats));
+            writeFully(responsePipe, work.rankSeconds.data(), work.rankSeconds.size() * sizeof(double));
+        } catch (int) {
+            LOG(Error) << "Server: // Response // Sending response failed. Errno: " << errno;
+            throw;
+        }
+        LOG(Debug) << "Server: // Response // Response sent successfully. Amount of bytes sent: " << result.size();
+        if (metrics::Registry::instance().enabled()) {
+            metrics::Snapshot &snapshot = metrics::Registry::instance().local();
+            snapshot.framesServed++;
+            snapshot.bytesSent += result.size();
+            snapshot.cacheHits = renderer.tileCache().hitCount();
+            snapshot.cacheMisses = renderer.tileCache().missCount();
+            metrics::Registry::instance().writeIfDue();
+        }
+    }
+}
 
-                    colors::RGB rgb = colors::RGBColor(inMandelbrot(x_val, y_val, iterations), iterations);
-                    block_of_lines[y * width * 3 + x * 3] = rgb.R;
-                    block_of_lines[y * width * 3 + x * 3 + 1] = rgb.G;
-                    block_of_lines[y * width * 3 + x * 3 + 2] = rgb.B;
-                }
+int main(int argc, char *argv[]) {
+    upcxx::init();
 
-            }
-        }
-        upcxx::barrier();
-        if (proc_id == 0) {
-            for (int proc = 1; proc < num_procs; proc++) {
-                int linesForThread;
-                if (proc == num_procs - 1) {
-                    linesForThread = height - (num_procs - 2) * (height / (num_procs - 1));
-                } else {
-                    linesForThread = height / (num_procs - 1);
-                }
-                std::vector<char> block_of_lines(linesForThread * width * 3);
-                upcxx::rget(
-                        global_line.fetch(proc).wait(),
-                        block_of_lines.data(),
-                        linesForThread * width * 3).wait();
-                result.insert(std::end(result), std::begin(block_of_lines), std::end(block_of_lines));
-            }
-            std::cout << "Server: // Response // Sending response.." << std::endl;
-            std::chrono::duration<double> diff = std::chrono::steady_clock::now() - begin_time;
-            std::cout << "Server: // Response // Calculations took " << (diff.count()) << " seconds." << std::endl;
-            status = write(responsePipe, result.data(), result.size());
-            if (status == -1) {
-                std::cout << "Server: // Response // Sending response failed. Errno: " << status << std::endl;
-                throw -1;
-            }
-            std::cout << "Server: // Response // Response sent successfully. Amount of bytes sent: " << status
-                      << std::endl;
+    proc_id = upcxx::rank_me();
+    num_procs = upcxx::rank_n();
+    Options options = parseOptions(argc, argv);
+    logging::Logger::instance().setLevel(options.logLevel);
+    if (options.pngThreads >= 0)
+        image::compressionThreads() = options.pngThreads;
+
+    if (!options.tracePath.empty())
+        trace::Recorder::instance().start();
+    if (options.perfCounters)
+        counters::Sampler::instance().start();
+    if (!options.metricsPath.empty())
+        metrics::Registry::instance().start(options.metricsPath, options.metricsSeconds);
+
+    engine::Engine engine;
+    if (proc_id == 0) {
+        if (options.frames > 0 && options.exponentialMap) {
+            expmap::render(engine, options);
+        } else if (options.frames > 0) {
+            animation::render(engine, options);
+        } else if (!options.scenesPath.empty()) {
+            scenes::find(engine, options);
+        } else if (!options.pyramidPath.empty()) {
+            pyramid::render(engine, options);
+        } else if (!options.outputPath.empty()) {
+            renderToFile(engine, options);
+        } else {
+            std::unique_ptr<tiles::TileStore> store;
+            if (!options.tileStorePath.empty())
+                store.reset(new tiles::TileStore(options.tileStorePath, options.tileStoreBytes));
+            FrameRenderer renderer(engine, options.tileCacheBytes, store.get());
+            serveClient(engine, renderer);
         }
-        upcxx::barrier();
-        upcxx::delete_array(*global_line);
+        engine.stop();
+    } else {
+        engine.serve();
     }
+    metrics::Registry::instance().finish();
+    if (!options.tracePath.empty())
+        trace::Recorder::instance().write(options.tracePath);
+    if (options.perfCounters)
+        counters::Sampler::instance().report();
     upcxx::finalize();
 }
@@ -0,0 +1,68 @@
+#ifndef MANDELBROT_GUARD
+#define MANDELBROT_GUARD
+
+#include <cmath>
+
+inline double rSq(double Re, double Im) {
+    return Re * Re + Im * Im;
+}
+
+inline unsigned int inMandelbrot(double x, double y, int max_iterations) {
+    int iteration = 0;
+    double Re = 0;
+    double Im = 0;
+    while (rSq(Re, Im) <= 4 && iteration < max_iterations) {
+        double Re_temp = Re * Re - Im * Im + x;
+        Im = 2 * Re * Im + y;
+        Re = Re_temp;
+        iteration++;
+    }
+    return iteration;
+}
+
+// Region of the complex plane shown in a window of width x height pixels.
+// Pixel (x, y) lies at (leftTopX + x * stepX, leftTopY - y * stepY).
+struct Viewport {
+    int width;
+    int height;
+    double leftTopX;
+    double leftTopY;
+    double rightBottomX;
+    double rightBottomY;
+
+    double stepX() const { return (rightBottomX - leftTopX) / width; }
+
+    double stepY() const { return (leftTopY - rightBottomY) / height; }
+};
+
+// Rectangle of pixels within a viewport.
+struct Region {
+    int x;
+    int y;
+    int width;
+    int height;
+
+    long long pixels() const { return (long long) width * height; }
+};
+
+// Part of the region that lies inside the viewport, possibly empty.
+inline Region clip(const Region &region, const Viewport &viewport) {
+    int left = region.x < 0 ? 0 : region.x;
+    int top = region.y < 0 ? 0 : region.y;
+    int right = region.x + region.width > viewport.width ? viewport.width : region.x + region.width;
+    int bottom = region.y + region.height > viewport.height ? viewport.height : region.y + region.height;
+    if (right <= left || bottom <= top)
+        return Region{left, top, 0, 0};
+    return Region{left, top, right - left, bottom - top};
+}
+
+// The deeper we zoom, the more iterations it takes to tell the boundary apart.
+inline int iterationCap(const Viewport &viewport) {
+    double surface = (viewport.rightBottomX - viewport.leftTopX) * (viewport.leftTopY - viewport.rightBottomY);
+    int iterations = 300 / sqrt(surface);
+    if (iterations > 2000)
+        iterations = 2000;
+    return iterations;
+}
+
+#endif // MANDELBROT_GUARD
@@ -0,0 +1,246 @@
+#ifndef METRICS_GUARD
+#define METRICS_GUARD
+
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "logger.hpp"
+
+// Counters and phase latency histograms of a long running server, written
+// in the Prometheus text format for node_exporter's textfile collector.
+// Every rank counts into its own snapshot in shared memory. The workers only
+// touch theirs while computing a slice, so rank 0 can read them one-sided
+// between frames without stopping them for a collective.
+namespace metrics{
+
+enum Phase{
+    Frame,
+    Render,
+    Compute,
+    Gather,
+    Color,
+    PipeWrite,
+    PhaseCount,
+};
+
+inline const char *phaseName(Phase phase){
+    static const char *names[PhaseCount] = {"frame", "render", "compute", "gather", "color", "pipe_write"};
+    return names[phase];
+}
+
+const int BucketCount = 14;
+// upper bounds in seconds, the last bucket is +Inf
+const double BucketBounds[BucketCount - 1] = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5,
+                                              5, 10};
+
+struct Histogram{
+    uint64_t counts[BucketCount];
+    uint64_t count;
+    double sum;
+
+    void observe(double seconds){
+        int bucket = 0;
+        while(bucket < BucketCount - 1 && seconds > BucketBounds[bucket])
+            bucket++;
+        counts[bucket]++;
+        count++;
+        sum += seconds;
+    }
+
+    void add(const Histogram &other){
+        for(int bucket = 0; bucket < BucketCount; bucket++)
+            counts[bucket] += other.counts[bucket];
+        count += other.count;
+        sum += other.sum;
+    }
+};
+
+struct Snapshot{
+    // rank 0 only
+    uint64_t framesServed;
+    uint64_t bytesSent;
+    uint64_t cacheHits;
+    uint64_t cacheMisses;
+    // every rank that computes
+    uint64_t pixels;
+    uint64_t iterations;
+    double computeSeconds;
+    Histogram phases[PhaseCount];
+};
+
+class Registry{
+public:
+    static Registry &instance(){
+        static Registry registry;
+        return registry;
+    }
+
+    bool enabled() const{ return on; }
+
+    Snapshot &local(){ return *shared.local(); }
+
+    // Collective. Rank 0 learns where every rank keeps its snapshot.
+    void start(const std::string &path, int intervalSeconds){
+        this->path = path;
+        interval = std::chrono::seconds(intervalSeconds);
+        shared = upcxx::new_array<Snapshot>(1);
+        std::memset(shared.local(), 0, sizeof(Snapshot));
+        upcxx::dist_object<upcxx::global_ptr<Snapshot>> published(shared);
+        upcxx::barrier();
+        if(upcxx::rank_me() == 0)
+            for(int rank = 1; rank < upcxx::rank_n(); rank++)
+                remote.push_back(published.fetch(rank).wait());
+        upcxx::barrier();
+        lastWrite = std::chrono::steady_clock::now();
+        on = true;
+    }
+
+    void observe(Phase phase, double seconds){
+        local().phases[phase].observe(seconds);
+    }
+
+    // Any rank, after computing a slice.
+    void computed(int64_t pixels, uint64_t iterations, double seconds){
+        if(!on)
+            return;
+        local().pixels += pixels;
+        local().iterations += iterations;
+        local().computeSeconds += seconds;
+    }
+
+    // Rank 0 only, between frames. Writes the metrics once the interval has
+    // passed since the last write.
+    void writeIfDue(){
+        if(on && std::chrono::steady_clock::now() - lastWrite >= interval)
+            write();
+    }
+
+    // Collective. Rank 0 writes the final metrics before the snapshots go away.
+    void finish(){
+        if(!on)
+            return;
+        if(upcxx::rank_me() == 0)
+            write();
+        on = false;
+        upcxx::barrier();
+        upcxx::delete_array(shared);
+    }
+
+private:
+    Registry() = default;
+
+    // Rank 0 only. Sums the snapshots of all ranks and replaces the file in one rename.
+    void write(){
+        lastWrite = std::chrono::steady_clock::now();
+        std::vector<Snapshot> ranks(1, local());
+        for(const upcxx::global_ptr<Snapshot> &snapshot : remote){
+            ranks.emplace_back();
+            upcxx::rget(snapshot, &ranks.back(), 1).wait();
+        }
+        Snapshot total = ranks[0];
+        for(size_t rank = 1; rank < ranks.size(); rank++){
+            total.pixels += ranks[rank].pixels;
+            total.iterations += ranks[rank].iterations;
+            total.computeSeconds += ranks[rank].computeSeconds;
+            for(int phase = 0; phase < PhaseCount; phase++)
+                total.phases[phase].add(ranks[rank].phases[phase]);
+        }
+
+        std::string temporary = path + ".tmp";
+        std::FILE *file = std::fopen(temporary.c_str(), "w");
+        if(!file){
+            LOG(Warning) << "Server: // Metrics  // Cannot write " << temporary << ". Errno: " << errno;
+            return;
+        }
+        counter(file, "mandelbrot_frames_served_total", "Frames sent to the client.", total.framesServed);
+        counter(file, "mandelbrot_bytes_sent_total", "Bytes of frames sent to the client.", total.bytesSent);
+        counter(file, "mandelbrot_tile_cache_hits_total", "Tiles found in the tile cache.", total.cacheHits);
+        counter(file, "mandelbrot_tile_cache_misses_total", "Tiles missing from the tile cache.", total.cacheMisses);
+        counter(file, "mandelbrot_pixels_computed_total", "Pixels computed, over all ranks.", total.pixels);
+        counter(file, "mandelbrot_iterations_total", "Iterations computed, over all ranks.", total.iterations);
+
+        std::fprintf(file, "# HELP mandelbrot_rank_pixels_computed_total Pixels computed by each rank.\n"
+                           "# TYPE mandelbrot_rank_pixels_computed_total counter\n");
+        for(size_t rank = 0; rank < ranks.size(); rank++)
+            std::fprintf(file, "mandelbrot_rank_pixels_computed_total{rank=\"%zu\"} %llu\n", rank,
+                         (unsigned long long) ranks[rank].pixels);
+        std::fprintf(file, "# HELP mandelbrot_rank_compute_seconds_total Seconds each rank spent computing.\n"
+                           "# TYPE mandelbrot_rank_compute_seconds_total counter\n");
+        for(size_t rank = 0; rank < ranks.size(); rank++)
+            std::fprintf(file, "mandelbrot_rank_compute_seconds_total{rank=\"%zu\"} %.9g\n", rank,
+                         ranks[rank].computeSeconds);
+
+        std::fprintf(file, "# HELP mandelbrot_phase_seconds Time spent per phase of a frame, over all ranks.\n"
+                           "# TYPE mandelbrot_phase_seconds histogram\n");
+        for(int phase = 0; phase < PhaseCount; phase++){
+            const Histogram &histogram = total.phases[phase];
+            const char *name = phaseName(Phase(phase));
+            uint64_t cumulative = 0;
+            for(int bucket = 0; bucket < BucketCount; bucket++){
+                cumulative += histogram.counts[bucket];
+                if(bucket < BucketCount - 1)
+                    std::fprintf(file, "mandelbrot_phase_seconds_bucket{phase=\"%s\",le=\"%g\"} %llu\n", name,
+                                 BucketBounds[bucket], (unsigned long long) cumulative);
+                else
+                    std::fprintf(file, "mandelbrot_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n", name,
+                                 (unsigned long long) cumulative);
+            }
+            std::fprintf(file, "mandelbrot_phase_seconds_sum{phase=\"%s\"} %.9g\n", name, histogram.sum);
+            std::fprintf(file, "mandelbrot_phase_seconds_count{phase=\"%s\"} %llu\n", name,
+                         (unsigned long long) histogram.count);
+        }
+        bool written = std::fclose(file) == 0;
+        if(!written || std::rename(temporary.c_str(), path.c_str()) != 0)
+            LOG(Warning) << "Server: // Metrics  // Cannot replace " << path << ". Errno: " << errno;
+    }
+
+    static void counter(std::FILE *file, const char *name, const char *help, uint64_t value){
+        std::fprintf(file, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name,
+                     (unsigned long long) value);
+    }
+
+    bool on = false;
+    std::string path;
+    std::chrono::steady_clock::duration interval;
+    std::chrono::steady_clock::time_point lastWrite;
+    upcxx::global_ptr<Snapshot> shared;
+    // rank 0 only, the snapshots of ranks 1..n-1
+    std::vector<upcxx::global_ptr<Snapshot>> remote;
+};
+
+// Adds the time from its construction to its destruction to the phase's histogram.
+class Timer{
+public:
+    explicit Timer(Phase phase)
+            : phase(phase), active(Registry::instance().enabled()), begin(std::chrono::steady_clock::now()){}
+
+    ~Timer(){
+        if(active)
+            Registry::instance().observe(phase, seconds());
+    }
+
+    // Since construction, also while metrics are off.
+    double seconds() const{
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    Timer(const Timer &) = delete;
+
+    Timer &operator=(const Timer &) = delete;
+
+private:
+    Phase phase;
+    bool active;
+    std::chrono::steady_clock::time_point begin;
+};
+
+} // namespace metrics
+
+#endif // METRICS_GUARD
@@ -0,0 +1,193 @@
+#ifndef OPTIONS_GUARD
+#define OPTIONS_GUARD
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "logger.hpp"
+#include "mandelbrot.hpp"
+
+enum class Easing {
+    Linear,
+    Smooth,
+};
+
+// Command line of the server. Every rank parses the same arguments.
+struct Options {
+    // off by default: cold frames compute whole tiles, more points than the frame has pixels
+    size_t tileCacheBytes = 0;
+    std::string tileStorePath;
+    size_t tileStoreBytes = size_t(4096) << 20;
+
+    // Batch rendering: with an output path the server renders the view to
+    // that file instead of serving the client.
+    std::string outputPath;
+    Viewport view{600, 720, -2, 1.5, 0.5, -1.5};
+    // 0 picks the cap from the size of the view, like for the client.
+    int iterations = 0;
+
+    // Rank 0's memory for the image being rendered, which is written out in bands.
+    size_t memoryBudgetBytes = size_t(256) << 20;
+    // Negative leaves the default of one thread per core.
+    int pngThreads = -1;
+
+    // Seconds between checkpoints of offline renders, 0 for none.
+    int checkpointSeconds = 0;
+
+    // Chrome trace of every rank's phases, written when the server stops.
+    std::string tracePath;
+
+    // Hardware counters of the compute and gather phases, printed when the server stops.
+    bool perfCounters = false;
+
+    // Most detailed messages printed, debug adds every request of the client.
+    logging::Level logLevel = logging::Info;
+
+    // Prometheus text file of counters and phase latencies, rewritten every metricsSeconds while serving.
+    std::string metricsPath;
+    int metricsSeconds = 10;
+
+    int iterationCap() const { return iterations > 0 ? iterations : ::iterationCap(view); }
+
+    // Deep Zoom pyramid of the view, written as pyramidPath.dzi and pyramidPath_files.
+    std::string pyramidPath;
+
+    // Scene finder: a library of views around nuclei and Misiurewicz points, written to scenesPath.
+    std::string scenesPath;
+    int maxPeriod = 10;
+    int scenesPerKind = 4;
+
+    // Animation: frames from view to endView, written to numbered files.
+    int frames = 0;
+    Viewport endView{600, 720, -2, 1.5, 0.5, -1.5};
+    Easing easing = Easing::Smooth;
+    // Resample all frames from one exponential map strip around the center of endView.
+    bool exponentialMap = false;
+};
+
+inline void printUsage(const char *program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl
+              << "  --tile-cache-mb N   cache world-aligned tiles in N MB and snap pixels to them; off by default,"
+              << std::endl
+              << "                      which renders every frame exactly" << std::endl
+              << "  --tile-store PATH   keep computed tiles in this file across runs, needs the tile cache" << std::endl
+              << "  --tile-store-mb N   largest size of the tile store file (default 4096)" << std::endl
+              << "  --trace FILE        write a Chrome trace of what every rank did to FILE on exit" << std::endl
+              << "  --perf-counters     count cycles, instructions, branch misses and FP operations" << std::endl
+              << "                      of every rank's compute and gather phases, printed on exit" << std::endl
+              << "  --log-level LEVEL   error, warning, info (default) or debug, which logs every request"
+              << std::endl
+              << "  --metrics FILE      keep Prometheus metrics of frames, pixels, iterations and phase" << std::endl
+              << "                      latencies of all ranks in FILE" << std::endl
+              << "  --metrics-every S   seconds between rewrites of the metrics while serving (default 10)"
+              << std::endl
+              << "Batch rendering, without the client:" << std::endl
+              << "  --output FILE       render to FILE, PNG when it ends in .png, PPM otherwise" << std::endl
+              << "  --size WxH          image size in pixels (default 600x720)" << std::endl
+              << "  --view X0 Y0 X1 Y1  left top and right bottom corners (default -2 1.5 0.5 -1.5)" << std::endl
+              << "  --iterations N      iteration cap (default depends on the view)" << std::endl
+              << "  --memory-mb N       memory for image bands in flight (default 256)" << std::endl
+              << "  --png-threads N     threads compressing PNG output, 0 stores it uncompressed" << std::endl
+              << "                      (default: one per core)" << std::endl
+              << "  --checkpoint S      save progress every S seconds to OUTPUT.checkpoint and carry on" << std::endl
+              << "                      from there when restarted with the same view, --expmap keeps its" << std::endl
+              << "                      strip in OUTPUT.strip" << std::endl
+              << "  --pyramid NAME      write the view as Deep Zoom tiles NAME.dzi and NAME_files/" << std::endl
+              << "Scene finder, writes views of the --size for benchmarks:" << std::endl
+              << "  --find-scenes FILE  search minibrot nuclei and Misiurewicz points, rate and list them"
+              << std::endl
+              << "  --max-period N      highest period plus preperiod searched (default 10)" << std::endl
+              << "  --scenes-per-kind N views kept per period and preperiod (default 4)" << std::endl
+              << "Zoom animation, --output is a printf pattern such as zoom_%05d.png:" << std::endl
+              << "  --frames N          number of frames from --view to --to" << std::endl
+              << "  --to X0 Y0 X1 Y1    view of the last frame" << std::endl
+              << "  --easing NAME       linear or smooth (default)" << std::endl
+              << "  --expmap            resample the frames from one log-polar strip, zooming" << std::endl
+              << "                      into the center of --to" << std::endl;
+}
+
+inline Options parseOptions(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--tile-cache-mb" && hasValue) {
+            options.tileCacheBytes = size_t(std::strtoull(argv[++i], nullptr, 10)) << 20;
+        } else if (option == "--tile-store" && hasValue) {
+            options.tileStorePath = argv[++i];
+        } else if (option == "--tile-store-mb" && hasValue) {
+            options.tileStoreBytes = size_t(std::strtoull(argv[++i], nullptr, 10)) << 20;
+        } else if (option == "--trace" && hasValue) {
+            options.tracePath = argv[++i];
+        } else if (option == "--perf-counters") {
+            options.perfCounters = true;
+        } else if (option == "--log-level" && hasValue && logging::parseLevel(argv[i + 1], options.logLevel)) {
+            i++;
+        } else if (option == "--metrics" && hasValue) {
+            options.metricsPath = argv[++i];
+        } else if (option == "--metrics-every" && hasValue) {
+            options.metricsSeconds = std::atoi(argv[++i]);
+        } else if (option == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        } else if (option == "--size" && hasValue &&
+                   std::sscanf(argv[++i], "%dx%d", &options.view.width, &options.view.height) == 2) {
+        } else if (option == "--view" && i + 4 < argc) {
+            options.view.leftTopX = std::atof(argv[++i]);
+            options.view.leftTopY = std::atof(argv[++i]);
+            options.view.rightBottomX = std::atof(argv[++i]);
+            options.view.rightBottomY = std::atof(argv[++i]);
+        } else if (option == "--iterations" && hasValue) {
+            options.iterations = std::atoi(argv[++i]);
+        } else if (option == "--expmap") {
+            options.exponentialMap = true;
+        } else if (option == "--pyramid" && hasValue) {
+            options.pyramidPath = argv[++i];
+        } else if (option == "--find-scenes" && hasValue) {
+            options.scenesPath = argv[++i];
+        } else if (option == "--max-period" && hasValue) {
+            options.maxPeriod = std::atoi(argv[++i]);
+        } else if (option == "--scenes-per-kind" && hasValue) {
+            options.scenesPerKind = std::atoi(argv[++i]);
+        } else if (option == "--png-threads" && hasValue) {
+            options.pngThreads = std::atoi(argv[++i]);
+        } else if (option == "--checkpoint" && hasValue) {
+            options.checkpointSeconds = std::atoi(argv[++i]);
+        } else if (option == "--memory-mb" && hasValue) {
+            options.memoryBudgetBytes = size_t(std::strtoull(argv[++i], nullptr, 10)) << 20;
+        } else if (option == "--frames" && hasValue) {
+            options.frames = std::atoi(argv[++i]);
+        } else if (option == "--to" && i + 4 < argc) {
+            options.endView.leftTopX = std::atof(argv[++i]);
+            options.endView.leftTopY = std::atof(argv[++i]);
+            options.endView.rightBottomX = std::atof(argv[++i]);
+            options.endView.rightBottomY = std::atof(argv[++i]);
+        } else if (option == "--easing" && hasValue && (std::strcmp(argv[i + 1], "linear") == 0 ||
+                                                         std::strcmp(argv[i + 1], "smooth") == 0)) {
+            options.easing = std::strcmp(argv[++i], "linear") == 0 ? Easing::Linear : Easing::Smooth;
+        } else {
+            LOG(Error) << "Server: // Options  // Unknown option " << option;
+            printUsage(argv[0]);
+            throw -1;
+        }
+    }
+    options.endView.width = options.view.width;
+    options.endView.height = options.view.height;
+    if (options.frames > 0 && options.outputPath.empty()) {
+        LOG(Error) << "Server: // Options  // --frames needs --output";
+        throw -1;
+    }
+    if (!options.tileStorePath.empty() && options.tileCacheBytes == 0) {
+        LOG(Error) << "Server: // Options  // --tile-store needs the tile cache of --tile-cache-mb";
+        throw -1;
+    }
+    if (options.view.width <= 0 || options.view.height <= 0) {
+        LOG(Error) << "Server: // Options  // Image size has to be positive";
+        throw -1;
+    }
+    return options;
+}
+
+#endif // OPTIONS_GUARD
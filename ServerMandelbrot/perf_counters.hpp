@@ -0,0 +1,223 @@
+#ifndef PERF_COUNTERS_GUARD
+#define PERF_COUNTERS_GUARD
+
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <upcxx/upcxx.hpp>
+#include "gather.hpp"
+#include "logger.hpp"
+
+// Hardware counters of the calling thread around the compute and gather
+// phases of every frame, on every rank, read with perf_event_open. Counters
+// the processor or the kernel's perf_event_paranoid setting do not allow are
+// left out. The floating point ones are Intel's FP_ARITH_INST_RETIRED
+// events for doubles and are left out on other processors.
+namespace counters{
+
+enum Counter{
+    Cycles,
+    Instructions,
+    BranchMisses,
+    ScalarDouble,
+    Packed128Double,
+    Packed256Double,
+    CounterCount,
+};
+
+enum Phase{
+    Compute,
+    Gather,
+    PhaseCount,
+};
+
+inline const char *phaseName(Phase phase){
+    return phase == Compute ? "compute" : "gather";
+}
+
+struct Totals{
+    double seconds;
+    double values[CounterCount];
+    int64_t samples;
+};
+
+inline bool intelProcessor(){
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while(std::getline(cpuinfo, line))
+        if(line.compare(0, 9, "vendor_id") == 0)
+            return line.find("GenuineIntel") != std::string::npos;
+    return false;
+}
+
+class Sampler{
+public:
+    static Sampler &instance(){
+        static Sampler sampler;
+        return sampler;
+    }
+
+    ~Sampler(){
+        for(int fileDescriptor : fileDescriptors)
+            if(fileDescriptor != -1)
+                close(fileDescriptor);
+    }
+
+    bool enabled() const{ return on; }
+
+    // Every rank opens its own counters.
+    void start(){
+        std::memset(totals, 0, sizeof(totals));
+        fileDescriptors[Cycles] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fileDescriptors[Instructions] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fileDescriptors[BranchMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        bool intel = intelProcessor();
+        // event 0xc7 with the umask of the instruction kind
+        fileDescriptors[ScalarDouble] = intel ? open(PERF_TYPE_RAW, 0x01c7) : -1;
+        fileDescriptors[Packed128Double] = intel ? open(PERF_TYPE_RAW, 0x04c7) : -1;
+        fileDescriptors[Packed256Double] = intel ? open(PERF_TYPE_RAW, 0x10c7) : -1;
+        on = true;
+        if(fileDescriptors[Cycles] == -1 && upcxx::rank_me() == 0)
+            LOG(Warning) << "Server: // Counters // Hardware counters are not available: " << openError
+                         << ", only wall time is measured";
+    }
+
+    void read(double values[CounterCount]){
+        for(int counter = 0; counter < CounterCount; counter++){
+            values[counter] = 0;
+            uint64_t reading[3];
+            if(fileDescriptors[counter] == -1 ||
+               ::read(fileDescriptors[counter], reading, sizeof(reading)) != ssize_t(sizeof(reading)))
+                continue;
+            // scaled up when the counter had to share the hardware with others
+            values[counter] = reading[2] > 0 ? double(reading[0]) * reading[1] / reading[2] : 0;
+        }
+    }
+
+    void add(Phase phase, double seconds, const double begin[CounterCount], const double end[CounterCount]){
+        totals[phase].seconds += seconds;
+        for(int counter = 0; counter < CounterCount; counter++)
+            totals[phase].values[counter] += end[counter] - begin[counter];
+        totals[phase].samples++;
+    }
+
+    // Collective. Rank 0 prints the totals of every rank and phase.
+    void report(){
+        std::vector<Totals> mine(totals, totals + PhaseCount);
+        std::vector<int> opened;
+        for(int fileDescriptor : fileDescriptors)
+            opened.push_back(fileDescriptor != -1);
+        std::vector<std::vector<Totals>> ranks = gatherToRoot(mine);
+        std::vector<std::vector<int>> available = gatherToRoot(opened);
+        on = false;
+        if(upcxx::rank_me() != 0)
+            return;
+        char line[160];
+        std::snprintf(line, sizeof(line), "%4s %-7s %7s %10s %10s %10s %6s %9s %10s %8s %7s", "rank", "phase",
+                      "samples", "wall s", "Gcycles", "Ginstr", "IPC", "br-miss/k", "GFLOP", "flop/cyc", "packed");
+        LOG(Info) << "Server: // Counters // " << line;
+        for(size_t rank = 0; rank < ranks.size(); rank++){
+            for(int phase = 0; phase < PhaseCount; phase++){
+                const Totals &total = ranks[rank][phase];
+                if(total.samples == 0)
+                    continue;
+                const double *value = total.values;
+                int length = std::snprintf(line, sizeof(line), "%4zu %-7s %7lld %10.4f ", rank,
+                                           phaseName(Phase(phase)), (long long) total.samples, total.seconds);
+                if(available[rank][Cycles] && available[rank][Instructions])
+                    length += std::snprintf(line + length, sizeof(line) - length, "%10.4f %10.4f %6.2f ",
+                                            value[Cycles] / 1e9, value[Instructions] / 1e9,
+                                            value[Cycles] > 0 ? value[Instructions] / value[Cycles] : 0);
+                else
+                    length += std::snprintf(line + length, sizeof(line) - length, "%10s %10s %6s ", "n/a", "n/a",
+                                            "n/a");
+                if(available[rank][BranchMisses] && available[rank][Instructions])
+                    length += std::snprintf(line + length, sizeof(line) - length, "%9.3f ", value[Instructions] > 0
+                                            ? 1000 * value[BranchMisses] / value[Instructions] : 0);
+                else
+                    length += std::snprintf(line + length, sizeof(line) - length, "%9s ", "n/a");
+                if(available[rank][ScalarDouble] && available[rank][Packed128Double] &&
+                   available[rank][Packed256Double]){
+                    double flops = value[ScalarDouble] + 2 * value[Packed128Double] + 4 * value[Packed256Double];
+                    double instructions = value[ScalarDouble] + value[Packed128Double] + value[Packed256Double];
+                    std::snprintf(line + length, sizeof(line) - length, "%10.4f %8.3f %6.1f%%", flops / 1e9,
+                                  value[Cycles] > 0 ? flops / value[Cycles] : 0,
+                                  instructions > 0 ? 100 * (instructions - value[ScalarDouble]) / instructions : 0);
+                } else{
+                    std::snprintf(line + length, sizeof(line) - length, "%10s %8s %7s", "n/a", "n/a", "n/a");
+                }
+                LOG(Info) << "Server: // Counters // " << line;
+            }
+        }
+    }
+
+private:
+    Sampler(){
+        for(int &fileDescriptor : fileDescriptors)
+            fileDescriptor = -1;
+    }
+
+    int open(uint32_t type, uint64_t config){
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = type;
+        attributes.config = config;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fileDescriptor = int(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+        if(fileDescriptor == -1 && openError.empty())
+            openError = std::strerror(errno);
+        return fileDescriptor;
+    }
+
+    bool on = false;
+    int fileDescriptors[CounterCount];
+    std::string openError;
+    Totals totals[PhaseCount];
+};
+
+// Adds the counters and the wall time from its construction to its
+// destruction to the phase.
+class Measure{
+public:
+    explicit Measure(Phase phase) : phase(phase), active(Sampler::instance().enabled()){
+        if(!active)
+            return;
+        Sampler::instance().read(begin);
+        beginTime = std::chrono::steady_clock::now();
+    }
+
+    ~Measure(){
+        if(!active)
+            return;
+        std::chrono::duration<double> diff = std::chrono::steady_clock::now() - beginTime;
+        double end[CounterCount];
+        Sampler::instance().read(end);
+        Sampler::instance().add(phase, diff.count(), begin, end);
+    }
+
+    Measure(const Measure &) = delete;
+
+    Measure &operator=(const Measure &) = delete;
+
+private:
+    Phase phase;
+    bool active;
+    double begin[CounterCount];
+    std::chrono::steady_clock::time_point beginTime;
+};
+
+} // namespace counters
+
+#endif // PERF_COUNTERS_GUARD
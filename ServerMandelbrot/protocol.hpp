@@ -0,0 +1,102 @@
+#ifndef PROTOCOL_GUARD
+#define PROTOCOL_GUARD
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <unistd.h>
+
+#include "mandelbrot.hpp"
+
+// The wire format of the request pipe, which the client includes as well.
+enum RequestType : int {
+    // The whole windowWidth x windowHeight frame.
+    FrameRequest = 0,
+    // regionCount Regions follow the request, the response carries their
+    // pixels one region after another, each clipped to the window.
+    RegionRequest = 1,
+    // regionCount Viewports follow the request, each with its own size, and
+    // the response carries their pixels one viewport after another. The
+    // window of the request itself is not rendered.
+    ViewportsRequest = 2,
+};
+
+// Debug views of a FrameRequest, blended half and half with the fractal.
+// The frame is then computed as one job without the tile cache, so the
+// ownership shows how the engine splits a whole frame between the ranks.
+enum DebugView : int {
+    NoDebugView = 0,
+    // every pixel tinted with the color of the rank that computed it
+    OwnershipView = 1,
+    // every tile tinted by the iterations it took, from dark to light
+    CostView = 2,
+};
+
+struct Request {
+    bool connectionOk;
+    int windowWidth;
+    int windowHeight;
+    double leftTopX;
+    double leftTopY;
+    double rightBottomX;
+    double rightBottomY;
+    RequestType requestType;
+    // Regions or viewports following the request.
+    int regionCount;
+    DebugView debugView;
+};
+
+// Follows the pixels of every response: what the frame cost. rankCount
+// doubles follow it, the compute seconds of every rank; rank 0 only computes
+// when it is the only rank.
+struct FrameStats {
+    // rendering on rank 0, computing and assembling the iteration counts
+    double seconds;
+    // computed for the frame, tiles taken from the cache cost none
+    int64_t iterations;
+    // highest iteration cap of the frame
+    int iterationCap;
+    int rankCount;
+    // slowest computing rank over the mean of the computing ranks, minus one
+    double maxImbalance;
+    // mean distance of the computing ranks from their mean, over the mean
+    double meanImbalance;
+};
+
+inline Viewport requestViewport(const Request &request) {
+    return Viewport{request.windowWidth, request.windowHeight,
+                    request.leftTopX, request.leftTopY,
+                    request.rightBottomX, request.rightBottomY};
+}
+
+// Reads exactly size bytes. False when the other side has closed the pipe.
+inline bool readFully(int fileDescriptor, void *buffer, size_t size) {
+    char *bytes = static_cast<char *>(buffer);
+    while (size > 0) {
+        ssize_t status = read(fileDescriptor, bytes, size);
+        if (status == -1 && errno == EINTR)
+            continue;
+        if (status == -1)
+            throw -1;
+        if (status == 0)
+            return false;
+        bytes += status;
+        size -= status;
+    }
+    return true;
+}
+
+inline void writeFully(int fileDescriptor, const void *buffer, size_t size) {
+    const char *bytes = static_cast<const char *>(buffer);
+    while (size > 0) {
+        ssize_t status = write(fileDescriptor, bytes, size);
+        if (status == -1 && errno == EINTR)
+            continue;
+        if (status == -1)
+            throw -1;
+        bytes += status;
+        size -= status;
+    }
+}
+
+#endif // PROTOCOL_GUARD
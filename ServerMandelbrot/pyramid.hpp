@@ -0,0 +1,232 @@
+#ifndef PYRAMID_GUARD
+#define PYRAMID_GUARD
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+#include "batch.hpp"
+#include "checkpoint.hpp"
+#include "engine.hpp"
+#include "image_writer.hpp"
+#include "logger.hpp"
+#include "options.hpp"
+
+// Deep Zoom (DZI) image pyramid: NAME.dzi describes the image and
+// NAME_files/LEVEL/COLUMN_ROW.png holds its tiles. The last level is the
+// image itself, every level before it is half the size of the next one and
+// level 0 is a single pixel. Only the last level is rendered, the others are
+// reduced from it band by band, so the pyramid costs about one render.
+namespace pyramid{
+
+const int TileSize = 256;
+
+// Levels of an image of this size, down to the 1x1 level 0.
+inline int levelCount(int width, int height){
+    int levels = 1;
+    while((int64_t(1) << (levels - 1)) < std::max(width, height))
+        levels++;
+    return levels;
+}
+
+// Width or height of the level shift levels above the image, rounded up as DZI viewers do.
+inline int levelSize(int size, int shift){
+    return int((int64_t(size) + (int64_t(1) << shift) - 1) >> shift);
+}
+
+inline void makeDirectory(const std::string &path){
+    if(mkdir(path.c_str(), 0755) != 0 && errno != EEXIST){
+        LOG(Error) << "Server: // Pyramid  // Cannot create " << path << ". Errno: " << errno;
+        throw -1;
+    }
+}
+
+// Rows of one level waiting to fill a row of tiles. Full tile rows are
+// written out and handed on to the coarser level at half size.
+class Level{
+public:
+    Level(const std::string &directory, int level, int width, Level *coarser)
+            : directory(directory + "/" + std::to_string(level)), width(width), coarser(coarser){
+        makeDirectory(this->directory);
+    }
+
+    void push(const char *rgb, int rows){
+        pending.insert(pending.end(), rgb, rgb + size_t(rows) * width * 3);
+        pendingRows += rows;
+        while(pendingRows >= TileSize)
+            emit(TileSize);
+    }
+
+    void save(checkpoint::Record &record) const{
+        record.put(pendingRows);
+        record.put(tilesWritten);
+        record.putBytes(pending.data(), pending.size());
+    }
+
+    void restore(checkpoint::Record &record){
+        pendingRows = record.get<int>();
+        tilesWritten = record.get<int>();
+        std::string rows = record.getBytes();
+        pending.assign(rows.begin(), rows.end());
+    }
+
+    void finish(){
+        if(pendingRows > 0)
+            emit(pendingRows);
+        if(coarser)
+            coarser->finish();
+    }
+
+private:
+    // Tiles are far smaller than a deflate chunk, so the row's tiles are
+    // compressed side by side, by the PNG compression threads.
+    void emit(int rows){
+        const int columns = (width + TileSize - 1) / TileSize;
+        std::atomic<int> next(0);
+        std::atomic<bool> failed(false);
+        auto work = [&](){
+            try{
+                for(int column = next++; column < columns; column = next++)
+                    writeTile(column, rows);
+            } catch(int){
+                failed = true;
+            }
+        };
+        std::vector<std::thread> pool;
+        for(int thread = 1; thread < std::min(image::compressionThreads(), columns); thread++)
+            pool.emplace_back(work);
+        work();
+        for(std::thread &thread : pool)
+            thread.join();
+        if(failed)
+            throw -1;
+        tilesWritten++;
+        if(coarser)
+            coarser->push(reduce(rows).data(), (rows + 1) / 2);
+        pending.erase(pending.begin(), pending.begin() + size_t(rows) * width * 3);
+        pendingRows -= rows;
+    }
+
+    void writeTile(int column, int rows) const{
+        int tileWidth = std::min(TileSize, width - column * TileSize);
+        std::string path = directory + "/" + std::to_string(column) + "_" + std::to_string(tilesWritten) + ".png";
+        std::vector<char> block;
+        block.reserve(size_t(tileWidth) * rows * 3);
+        for(int row = 0; row < rows; row++){
+            const char *line = pending.data() + (size_t(row) * width + size_t(column) * TileSize) * 3;
+            block.insert(block.end(), line, line + tileWidth * 3);
+        }
+        std::unique_ptr<image::ImageWriter> tile = image::openImage(path, tileWidth, rows);
+        tile->writeRows(block.data(), rows);
+        tile->finish();
+    }
+
+    // Averages blocks of 2x2 pixels of the first rows pending rows. An odd last
+    // row or column is averaged with itself.
+    std::vector<char> reduce(int rows) const{
+        const int coarseWidth = (width + 1) / 2;
+        std::vector<char> reduced(size_t((rows + 1) / 2) * coarseWidth * 3);
+        const unsigned char *source = reinterpret_cast<const unsigned char *>(pending.data());
+        for(int y = 0; y < rows; y += 2){
+            const unsigned char *top = source + size_t(y) * width * 3;
+            const unsigned char *bottom = y + 1 < rows ? top + size_t(width) * 3 : top;
+            char *out = reduced.data() + size_t(y / 2) * coarseWidth * 3;
+            for(int x = 0; x < width; x += 2){
+                int right = x + 1 < width ? 3 : 0;
+                for(int channel = 0; channel < 3; channel++){
+                    int sum = top[x * 3 + channel] + top[x * 3 + right + channel] +
+                              bottom[x * 3 + channel] + bottom[x * 3 + right + channel];
+                    *out++ = char((sum + 2) / 4);
+                }
+            }
+        }
+        return reduced;
+    }
+
+    std::string directory;
+    int width;
+    Level *coarser;
+    std::vector<char> pending;
+    int pendingRows = 0;
+    int tilesWritten = 0;
+};
+
+inline void writeDescriptor(const std::string &path, int width, int height){
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if(!file){
+        LOG(Error) << "Server: // Pyramid  // Cannot write " << path << ". Errno: " << errno;
+        throw -1;
+    }
+    std::fprintf(file,
+                 "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                 "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" TileSize=\"%d\" Overlap=\"0\" Format=\"png\">\n"
+                 "  <Size Width=\"%d\" Height=\"%d\"/>\n"
+                 "</Image>\n", TileSize, width, height);
+    std::fclose(file);
+}
+
+// Renders the view of the options as the pyramid options.pyramidPath.dzi. Rank 0 only.
+// A checkpoint holds the rows rendered so far and the rows every level has
+// not written out as tiles yet.
+inline void render(engine::Engine &engine, const Options &options){
+    const Viewport &view = options.view;
+    const int levels = levelCount(view.width, view.height);
+    const int iterations = options.iterationCap();
+    const std::string directory = options.pyramidPath + "_files";
+    checkpoint::Checkpoint progress(options.pyramidPath + ".checkpoint",
+                                    checkpoint::describe("pyramid " + options.pyramidPath, view, iterations),
+                                    options.checkpointSeconds);
+    LOG(Info) << "Server: // Pyramid  // " << view.width << "x" << view.height << " in " << levels << " levels of "
+              << TileSize << "x" << TileSize << " tiles";
+    auto begin_time = std::chrono::steady_clock::now();
+
+    writeDescriptor(options.pyramidPath + ".dzi", view.width, view.height);
+    makeDirectory(directory);
+    std::vector<std::unique_ptr<Level>> pyramid(levels);
+    for(int level = 0; level < levels; level++){
+        int width = levelSize(view.width, levels - 1 - level);
+        pyramid[level].reset(new Level(directory, level, width, level > 0 ? pyramid[level - 1].get() : nullptr));
+    }
+
+    int startRow = 0;
+    if(progress.resuming()){
+        startRow = progress.restored().get<int>();
+        for(const std::unique_ptr<Level> &level : pyramid)
+            level->restore(progress.restored());
+        LOG(Info) << "Server: // Resume   // Carrying on from row " << startRow;
+    }
+
+    // Whole rows of tiles per band keep the finest level from buffering rows.
+    int rowsPerBand = std::max(TileSize, bandRows(options) / TileSize * TileSize);
+    Level &finest = *pyramid.back();
+    renderBands(engine, options, iterations, startRow, rowsPerBand, [&](const char *rgb, int firstRow, int rows){
+        finest.push(rgb, rows);
+        LOG(Info) << "Server: // Pyramid  // Rows " << firstRow << " - " << firstRow + rows - 1 << " done";
+        if(progress.due()){
+            checkpoint::Record record;
+            record.put(firstRow + rows);
+            for(const std::unique_ptr<Level> &level : pyramid)
+                level->save(record);
+            progress.save(record);
+        }
+    });
+    finest.finish();
+    progress.remove();
+
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - begin_time;
+    LOG(Info) << "Server: // Pyramid  // Wrote " << options.pyramidPath << ".dzi after " << diff.count()
+              << " seconds.";
+    printTimings(engine, diff.count());
+}
+
+} // namespace pyramid
+
+#endif // PYRAMID_GUARD
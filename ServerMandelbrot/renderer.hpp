@@ -0,0 +1,298 @@
+#ifndef RENDERER_GUARD
+#define RENDERER_GUARD
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "engine.hpp"
+#include "logger.hpp"
+#include "mandelbrot.hpp"
+#include "tile_cache.hpp"
+#include "tile_store.hpp"
+
+// Turns viewports into iteration counts on rank 0. With a tile cache the
+// frame is sampled from world aligned tiles at the power of two scale at or
+// just finer than the pixel spacing, so no two pixels share a sample and
+// revisited places only cost the tiles that are not cached yet.
+// Without one every pixel is computed exactly where it was asked for. Either
+// way pixels already known from the previous frame are reused when its pixel
+// grid lines up with the new one (a pan, a zoom out by a whole factor, a
+// bigger window).
+class FrameRenderer{
+public:
+    static const int MinTileLevel = -4;
+    static const int MaxTileLevel = 50;
+
+    // Tiles missing from the cache are looked up in the store, if there is one,
+    // before being computed, and computed tiles are added to it.
+    FrameRenderer(engine::Engine &engine, size_t tileCacheBytes, tiles::TileStore *store = nullptr)
+            : engine(engine), cache(tileCacheBytes), store(store), tiled(tileCacheBytes > 0){}
+
+    // Iteration counts of every pixel of the viewport, row after row. They stay
+    // valid until the next call, which may reuse them.
+    const std::vector<uint32_t> &render(const Viewport &viewport, int maxIterations){
+        Overlap known;
+        if(overlap(viewport, maxIterations, known))
+            lastFrame.counters = reuse(viewport, maxIterations, known);
+        else
+            lastFrame.counters = render(viewport, maxIterations, {Region{0, 0, viewport.width, viewport.height}});
+        lastFrame.viewport = viewport;
+        lastFrame.maxIterations = maxIterations;
+        return lastFrame.counters;
+    }
+
+    // Iteration counts of the pixels in each region, region after region, row after row.
+    // Regions have to lie inside the viewport, see clip().
+    std::vector<uint32_t> render(const Viewport &viewport, int maxIterations, const std::vector<Region> &regions){
+        int level;
+        if(tiled && tileLevel(viewport, level))
+            return renderTiled(viewport, maxIterations, level, regions);
+        std::vector<engine::Job> jobs;
+        for(const Region &region : regions){
+            if(region.pixels() == 0)
+                continue;
+            engine::Job job = engine::viewportJob(viewport, maxIterations);
+            job.x = region.x;
+            job.y = region.y;
+            job.width = region.width;
+            job.height = region.height;
+            jobs.push_back(job);
+        }
+        return jobs.empty() ? std::vector<uint32_t>() : engine.compute(jobs);
+    }
+
+    // Iteration counts of every pixel of each viewport, viewport after viewport.
+    // They are computed exactly, all in one go, so that many small views cost
+    // about as much as one view of as many pixels.
+    std::vector<uint32_t> render(const std::vector<Viewport> &viewports, const std::vector<int> &maxIterations){
+        std::vector<engine::Job> jobs;
+        for(size_t n = 0; n < viewports.size(); n++)
+            if(viewports[n].width > 0 && viewports[n].height > 0)
+                jobs.push_back(engine::viewportJob(viewports[n], maxIterations[n]));
+        return jobs.empty() ? std::vector<uint32_t>() : engine.compute(jobs);
+    }
+
+    const tiles::TileCache &tileCache() const{ return cache; }
+
+private:
+    // Tiles met along one axis of the frame, and where each pixel samples them.
+    struct Axis{
+        std::vector<int64_t> tiles;
+        std::vector<int> tileOf;
+        std::vector<int> offset;
+    };
+
+    struct LastFrame{
+        Viewport viewport;
+        int maxIterations;
+        std::vector<uint32_t> counters;
+    };
+
+    // Pixels of the new frame that are pixels of the previous one:
+    // new pixel (x, y) is old pixel (offsetX + factorX * x, offsetY + factorY * y)
+    // for x in [left, right) and y in [top, bottom).
+    struct Overlap{
+        int64_t factorX;
+        int64_t factorY;
+        int64_t offsetX;
+        int64_t offsetY;
+        int left;
+        int right;
+        int top;
+        int bottom;
+    };
+
+    static bool wholeNumber(double value, int64_t &rounded){
+        rounded = std::llround(value);
+        return std::fabs(value - rounded) < 1e-6;
+    }
+
+    // Range of n in [0, count) for which offset + factor * n falls in [0, limit).
+    static void overlapRange(int64_t offset, int64_t factor, int64_t limit, int count, int &from, int &to){
+        int64_t first = offset >= 0 ? 0 : (-offset + factor - 1) / factor;
+        int64_t last = offset >= limit ? -1 : (limit - 1 - offset) / factor;
+        from = int(std::min<int64_t>(first, count));
+        to = int(std::max<int64_t>(from, std::min<int64_t>(last + 1, count)));
+    }
+
+    bool overlap(const Viewport &viewport, int maxIterations, Overlap &result) const{
+        const Viewport &previous = lastFrame.viewport;
+        // Counts computed with a higher cap only need clamping to a lower one.
+        if(lastFrame.counters.empty() || lastFrame.maxIterations < maxIterations)
+            return false;
+        if(!wholeNumber(viewport.stepX() / previous.stepX(), result.factorX) || result.factorX < 1 ||
+           !wholeNumber(viewport.stepY() / previous.stepY(), result.factorY) || result.factorY < 1 ||
+           !wholeNumber((viewport.leftTopX - previous.leftTopX) / previous.stepX(), result.offsetX) ||
+           !wholeNumber((previous.leftTopY - viewport.leftTopY) / previous.stepY(), result.offsetY))
+            return false;
+        overlapRange(result.offsetX, result.factorX, previous.width, viewport.width, result.left, result.right);
+        overlapRange(result.offsetY, result.factorY, previous.height, viewport.height, result.top, result.bottom);
+        return result.left < result.right && result.top < result.bottom;
+    }
+
+    // The known part of the frame copied from the previous one, the strips
+    // around it rendered like any other regions.
+    std::vector<uint32_t> reuse(const Viewport &viewport, int maxIterations, const Overlap &known){
+        // Full width above and below the known part, then its sides.
+        std::vector<Region> strips;
+        auto strip = [&](int x, int y, int width, int height){
+            if(width > 0 && height > 0)
+                strips.push_back(Region{x, y, width, height});
+        };
+        strip(0, 0, viewport.width, known.top);
+        strip(0, known.bottom, viewport.width, viewport.height - known.bottom);
+        strip(0, known.top, known.left, known.bottom - known.top);
+        strip(known.right, known.top, viewport.width - known.right, known.bottom - known.top);
+        std::vector<uint32_t> computed = render(viewport, maxIterations, strips);
+        LOG(Debug) << "Server: // Reuse    // " << (known.right - known.left) << "x" << (known.bottom - known.top)
+                   << " pixels from the previous frame, " << computed.size() << " computed";
+
+        std::vector<uint32_t> frame(size_t(viewport.width) * viewport.height);
+        const std::vector<uint32_t> &previous = lastFrame.counters;
+        const uint32_t cap = maxIterations;
+        for(int y = known.top; y < known.bottom; y++){
+            const uint32_t *source = previous.data() + (known.offsetY + known.factorY * y) * lastFrame.viewport.width
+                                     + known.offsetX;
+            uint32_t *out = frame.data() + size_t(y) * viewport.width;
+            for(int x = known.left; x < known.right; x++)
+                out[x] = std::min(source[known.factorX * x], cap);
+        }
+        const uint32_t *counters = computed.data();
+        for(const Region &region : strips){
+            for(int row = 0; row < region.height; row++){
+                std::copy(counters, counters + region.width,
+                          frame.data() + size_t(region.y + row) * viewport.width + region.x);
+                counters += region.width;
+            }
+        }
+        return frame;
+    }
+
+    // Coarsest level whose sample spacing is no wider than the finer axis of
+    // the viewport. A coarser one would hand neighbouring pixels the same sample.
+    // False for an empty or degenerate window, which is rendered untiled.
+    static bool tileLevel(const Viewport &viewport, int &level){
+        double step = std::min(viewport.stepX(), viewport.stepY());
+        if(!std::isfinite(step) || !(step > 0))
+            return false;
+        level = int(std::ceil(-std::log2(step)));
+        return level >= MinTileLevel && level <= MaxTileLevel;
+    }
+
+    static int64_t floorDiv(int64_t value, int64_t divisor){
+        return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+
+    // Pixel n of the axis lies at origin + n * step, and samples the nearest tile point.
+    static Axis axis(int count, double origin, double step, int level){
+        Axis axis;
+        axis.tileOf.resize(count);
+        axis.offset.resize(count);
+        for(int n = 0; n < count; n++){
+            int64_t sample = std::llround(std::ldexp(origin + n * step, level));
+            int64_t tile = floorDiv(sample, tiles::TileSize);
+            if(axis.tiles.empty() || axis.tiles.back() != tile)
+                axis.tiles.push_back(tile);
+            axis.tileOf[n] = int(axis.tiles.size()) - 1;
+            axis.offset[n] = int(sample - tile * tiles::TileSize);
+        }
+        return axis;
+    }
+
+    std::vector<uint32_t> renderTiled(const Viewport &viewport, int maxIterations, int level,
+                                      const std::vector<Region> &regions){
+        Axis columns = axis(viewport.width, viewport.leftTopX, viewport.stepX(), level);
+        Axis rows = axis(viewport.height, -viewport.leftTopY, viewport.stepY(), level);
+        double step = std::ldexp(1.0, -level);
+
+        // Only tiles under one of the regions are needed.
+        std::vector<bool> needed(columns.tiles.size() * rows.tiles.size(), false);
+        for(const Region &region : regions){
+            if(region.pixels() == 0)
+                continue;
+            for(int row = rows.tileOf[region.y]; row <= rows.tileOf[region.y + region.height - 1]; row++)
+                for(int column = columns.tileOf[region.x];
+                    column <= columns.tileOf[region.x + region.width - 1]; column++)
+                    needed[row * columns.tiles.size() + column] = true;
+        }
+
+        std::vector<std::shared_ptr<const tiles::Tile>> grid(needed.size());
+        std::vector<tiles::TileKey> missingKeys;
+        std::vector<size_t> missingSlots;
+        std::vector<engine::Job> jobs;
+        size_t used = 0;
+        size_t loaded = 0;
+        for(size_t row = 0; row < rows.tiles.size(); row++){
+            for(size_t column = 0; column < columns.tiles.size(); column++){
+                size_t slot = row * columns.tiles.size() + column;
+                if(!needed[slot])
+                    continue;
+                used++;
+                tiles::TileKey key{level, columns.tiles[column], rows.tiles[row], maxIterations};
+                grid[slot] = cache.find(key);
+                if(!grid[slot] && store){
+                    grid[slot] = store->find(key);
+                    if(grid[slot]){
+                        cache.insert(key, grid[slot]);
+                        loaded++;
+                    }
+                }
+                if(grid[slot])
+                    continue;
+                missingKeys.push_back(key);
+                missingSlots.push_back(slot);
+                jobs.push_back(engine::Job{0, 0, step, step, key.tx * tiles::TileSize, key.ty * tiles::TileSize,
+                                           tiles::TileSize, tiles::TileSize, maxIterations,
+                                           engine::Mapping::Linear, 0});
+            }
+        }
+
+        if(!jobs.empty()){
+            std::vector<uint32_t> computed = engine.compute(jobs);
+            const size_t tilePixels = tiles::TileSize * tiles::TileSize;
+            for(size_t n = 0; n < jobs.size(); n++){
+                auto tile = std::make_shared<tiles::Tile>(computed.begin() + n * tilePixels,
+                                                          computed.begin() + (n + 1) * tilePixels);
+                cache.insert(missingKeys[n], tile);
+                if(store)
+                    store->append(missingKeys[n], *tile);
+                grid[missingSlots[n]] = tile;
+            }
+        }
+        LOG(Debug) << "Server: // Tiles    // Level " << level << ", " << used << " tiles, "
+                   << loaded << " loaded, " << jobs.size() << " computed, " << cache.size() << " cached ("
+                   << cache.memoryUsed() / (1 << 20) << " MB)";
+
+        long long pixels = 0;
+        for(const Region &region : regions)
+            pixels += region.pixels();
+        std::vector<uint32_t> result(pixels);
+        uint32_t *out = result.data();
+        std::vector<const uint32_t *> line(columns.tiles.size());
+        for(const Region &region : regions){
+            if(region.pixels() == 0)
+                continue;
+            int firstColumn = columns.tileOf[region.x];
+            int lastColumn = columns.tileOf[region.x + region.width - 1];
+            for(int y = region.y; y < region.y + region.height; y++){
+                for(int column = firstColumn; column <= lastColumn; column++)
+                    line[column] = grid[rows.tileOf[y] * columns.tiles.size() + column]->data()
+                                   + rows.offset[y] * tiles::TileSize;
+                for(int x = region.x; x < region.x + region.width; x++)
+                    *out++ = line[columns.tileOf[x]][columns.offset[x]];
+            }
+        }
+        return result;
+    }
+
+    engine::Engine &engine;
+    tiles::TileCache cache;
+    tiles::TileStore *store;
+    bool tiled;
+    LastFrame lastFrame;
+};
+
+#endif // RENDERER_GUARD
@@ -0,0 +1,256 @@
+#ifndef SCENES_GUARD
+#define SCENES_GUARD
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "engine.hpp"
+#include "logger.hpp"
+#include "mandelbrot.hpp"
+#include "options.hpp"
+
+// Finds places worth zooming into with Newton's method, so that benchmarks
+// can be run on reproducible views instead of hand picked coordinates:
+// nuclei of minibrots of a given period, and Misiurewicz points, where
+// filaments branch off. Every view is rated by a thumbnail computed by the
+// engine, from interior heavy to filament heavy.
+namespace scenes{
+
+typedef std::complex<double> Complex;
+
+enum class Kind{
+    Nucleus,
+    Misiurewicz,
+};
+
+struct Scene{
+    Kind kind;
+    int preperiod;
+    int period;
+    Complex center;
+    double width;
+    // measured on the thumbnail
+    int iterations;
+    double interior;
+    double meanIterations;
+};
+
+// Solves z_p(c) = 0 for a center c of a component of period p, starting from guess.
+inline bool nucleus(int period, Complex guess, Complex &c){
+    c = guess;
+    for(int step = 0; step < 64; step++){
+        Complex z = 0;
+        Complex dz = 0;
+        for(int i = 0; i < period; i++){
+            dz = 2.0 * z * dz + 1.0;
+            z = z * z + c;
+        }
+        if(std::norm(z) > 1e12 || std::norm(dz) == 0)
+            return false;
+        Complex delta = z / dz;
+        c -= delta;
+        if(std::norm(delta) < 1e-30 * (1 + std::norm(c)))
+            break;
+    }
+    // a nucleus of a divisor of the period is not one of this period
+    Complex z = 0;
+    for(int i = 1; i <= period; i++){
+        z = z * z + c;
+        if(std::abs(z) < 1e-9 && i < period)
+            return false;
+    }
+    return std::abs(z) < 1e-9 && std::abs(c) <= 2;
+}
+
+// Radius of the minibrot around a nucleus, after Robert Munafo's estimate.
+inline double nucleusSize(int period, Complex c){
+    Complex z = 0;
+    Complex l = 1;
+    Complex b = 1;
+    for(int i = 1; i < period; i++){
+        z = z * z + c;
+        l = 2.0 * z * l;
+        b += 1.0 / l;
+    }
+    return std::abs(1.0 / (b * l * l));
+}
+
+// Solves z_{k+p}(c) = z_k(c) for a point c whose orbit lands on a cycle of
+// period p after exactly k = preperiod steps. Also returns the derivative
+// of z_k at c, whose size tells how fine the structure around c is.
+inline bool misiurewicz(int preperiod, int period, Complex guess, Complex &c, double &scale){
+    c = guess;
+    std::vector<Complex> z(preperiod + period + 1);
+    std::vector<Complex> dz(preperiod + period + 1);
+    auto orbit = [&](){
+        z[0] = 0;
+        dz[0] = 0;
+        for(int i = 1; i <= preperiod + period; i++){
+            dz[i] = 2.0 * z[i - 1] * dz[i - 1] + 1.0;
+            z[i] = z[i - 1] * z[i - 1] + c;
+        }
+    };
+    for(int step = 0; step < 64; step++){
+        orbit();
+        Complex f = z[preperiod + period] - z[preperiod];
+        Complex df = dz[preperiod + period] - dz[preperiod];
+        if(std::norm(f) > 1e12 || std::norm(df) == 0)
+            return false;
+        Complex delta = f / df;
+        c -= delta;
+        if(std::norm(delta) < 1e-30 * (1 + std::norm(c)))
+            break;
+    }
+    orbit();
+    const double tolerance = 1e-9;
+    if(std::abs(z[preperiod + period] - z[preperiod]) > tolerance || std::abs(c) > 2)
+        return false;
+    // exactly this preperiod: the orbit was not on the cycle a step earlier
+    if(std::abs(z[preperiod + period - 1] - z[preperiod - 1]) < tolerance)
+        return false;
+    // exactly this period
+    for(int divisor = 1; divisor < period; divisor++)
+        if(period % divisor == 0 && std::abs(z[preperiod + divisor] - z[preperiod]) < tolerance)
+            return false;
+    scale = std::abs(dz[preperiod]);
+    return true;
+}
+
+// Newton started from a grid over the upper half of the set, the lower half
+// is its mirror image. Roots found more than once are kept once.
+template<typename Solve>
+std::vector<Complex> roots(Solve solve){
+    std::vector<Complex> found;
+    for(int row = 0; row <= 24; row++){
+        for(int column = 0; column <= 50; column++){
+            Complex c;
+            if(!solve(Complex(-2.05 + column * 0.05, row * 0.05), c))
+                continue;
+            c = Complex(c.real(), std::fabs(c.imag()));
+            bool known = false;
+            for(const Complex &root : found)
+                known = known || std::abs(root - c) < 1e-8;
+            if(!known)
+                found.push_back(c);
+        }
+    }
+    std::sort(found.begin(), found.end(), [](const Complex &a, const Complex &b){
+        return a.real() != b.real() ? a.real() < b.real() : a.imag() < b.imag();
+    });
+    return found;
+}
+
+// At most count of the roots, spread evenly over them.
+inline std::vector<Complex> spread(const std::vector<Complex> &found, size_t count){
+    if(found.size() <= count)
+        return found;
+    std::vector<Complex> picked;
+    for(size_t n = 0; n < count; n++)
+        picked.push_back(found[n * found.size() / count]);
+    return picked;
+}
+
+inline Viewport sceneView(const Scene &scene, int width, int height){
+    double viewHeight = scene.width * height / width;
+    return Viewport{width, height,
+                    scene.center.real() - scene.width / 2, scene.center.imag() + viewHeight / 2,
+                    scene.center.real() + scene.width / 2, scene.center.imag() - viewHeight / 2};
+}
+
+inline std::vector<Scene> search(const Options &options){
+    // Views narrower than this run out of double precision.
+    const double MinWidth = 1e-11;
+    std::vector<Scene> found;
+    for(int period = 1; period <= options.maxPeriod; period++){
+        std::vector<Complex> centers = roots([period](Complex guess, Complex &c){
+            return nucleus(period, guess, c);
+        });
+        for(const Complex &c : spread(centers, options.scenesPerKind)){
+            double width = std::min(4.0, 10 * nucleusSize(period, c));
+            if(width >= MinWidth)
+                found.push_back(Scene{Kind::Nucleus, 0, period, c, width, 0, 0, 0});
+        }
+    }
+    for(int period = 1; period <= 3; period++){
+        for(int preperiod = 2; preperiod + period <= options.maxPeriod; preperiod++){
+            std::vector<Complex> points = roots([preperiod, period](Complex guess, Complex &c){
+                double scale;
+                return misiurewicz(preperiod, period, guess, c, scale);
+            });
+            for(const Complex &c : spread(points, options.scenesPerKind)){
+                Complex point;
+                double scale = 1;
+                misiurewicz(preperiod, period, c, point, scale);
+                double width = std::min(4.0, 4 / scale);
+                if(width >= MinWidth)
+                    found.push_back(Scene{Kind::Misiurewicz, preperiod, period, c, width, 0, 0, 0});
+            }
+        }
+    }
+    return found;
+}
+
+// Share of interior pixels and mean iterations of every scene, from one
+// engine call computing a thumbnail of each.
+inline void rate(engine::Engine &engine, const Options &options, std::vector<Scene> &found){
+    const int ThumbnailWidth = 64;
+    const int thumbnailHeight = std::max(1, ThumbnailWidth * options.view.height / options.view.width);
+    std::vector<engine::Job> jobs;
+    for(Scene &scene : found){
+        Viewport view = sceneView(scene, ThumbnailWidth, thumbnailHeight);
+        scene.iterations = options.iterations > 0 ? options.iterations : iterationCap(view);
+        jobs.push_back(engine::viewportJob(view, scene.iterations));
+    }
+    if(jobs.empty())
+        return;
+    std::vector<uint32_t> counters = engine.compute(jobs);
+    const size_t pixels = size_t(ThumbnailWidth) * thumbnailHeight;
+    for(size_t n = 0; n < found.size(); n++){
+        size_t interior = 0;
+        double sum = 0;
+        for(size_t i = n * pixels; i < (n + 1) * pixels; i++){
+            interior += counters[i] >= uint32_t(found[n].iterations);
+            sum += counters[i];
+        }
+        found[n].interior = double(interior) / pixels;
+        found[n].meanIterations = sum / pixels;
+    }
+}
+
+// Writes the library of scenes to options.scenesPath, one view per line,
+// most interior first. Rank 0 only.
+inline void find(engine::Engine &engine, const Options &options){
+    LOG(Info) << "Server: // Scenes   // Searching periods up to " << options.maxPeriod;
+    std::vector<Scene> found = search(options);
+    rate(engine, options, found);
+    std::stable_sort(found.begin(), found.end(), [](const Scene &a, const Scene &b){
+        return a.interior > b.interior;
+    });
+
+    std::FILE *file = std::fopen(options.scenesPath.c_str(), "w");
+    if(!file){
+        LOG(Error) << "Server: // Scenes   // Cannot write " << options.scenesPath << ". Errno: " << errno;
+        throw -1;
+    }
+    std::fprintf(file, "# kind preperiod period leftTopX leftTopY rightBottomX rightBottomY iterations"
+                       " interior meanIterations\n");
+    for(const Scene &scene : found){
+        Viewport view = sceneView(scene, options.view.width, options.view.height);
+        std::fprintf(file, "%s %d %d %.17g %.17g %.17g %.17g %d %.4f %.1f\n",
+                     scene.kind == Kind::Nucleus ? "nucleus" : "misiurewicz", scene.preperiod, scene.period,
+                     view.leftTopX, view.leftTopY, view.rightBottomX, view.rightBottomY,
+                     options.iterations > 0 ? options.iterations : iterationCap(view),
+                     scene.interior, scene.meanIterations);
+    }
+    std::fclose(file);
+    LOG(Info) << "Server: // Scenes   // Wrote " << found.size() << " scenes to " << options.scenesPath;
+}
+
+} // namespace scenes
+
+#endif // SCENES_GUARD
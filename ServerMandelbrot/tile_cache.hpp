@@ -0,0 +1,98 @@
+#ifndef TILE_CACHE_GUARD
+#define TILE_CACHE_GUARD
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace tiles{
+
+// Tiles are squares of TileSize x TileSize iteration counts. At level L
+// neighbouring samples are 2^-L apart and sample (i, j) lies at
+// (i * 2^-L, -j * 2^-L), so the grid is the same for every request.
+const int TileSize = 64;
+
+struct TileKey{
+    int level;
+    int64_t tx;
+    int64_t ty;
+    int maxIterations;
+
+    bool operator==(const TileKey &other) const{
+        return level == other.level && tx == other.tx && ty == other.ty && maxIterations == other.maxIterations;
+    }
+};
+
+struct TileKeyHash{
+    size_t operator()(const TileKey &key) const{
+        size_t hash = std::hash<int64_t>()(key.tx);
+        hash = hash * 31 + std::hash<int64_t>()(key.ty);
+        hash = hash * 31 + std::hash<int>()(key.level);
+        return hash * 31 + std::hash<int>()(key.maxIterations);
+    }
+};
+
+typedef std::vector<uint32_t> Tile;
+
+// Least recently used tiles are dropped once their total size exceeds the budget.
+// Tiles are shared, so a frame being composed keeps its tiles even if they get evicted.
+class TileCache{
+public:
+    explicit TileCache(size_t budgetBytes) : budgetBytes(budgetBytes){}
+
+    std::shared_ptr<const Tile> find(const TileKey &key){
+        auto entry = index.find(key);
+        if(entry == index.end()){
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        recent.splice(recent.begin(), recent, entry->second);
+        return entry->second->second;
+    }
+
+    void insert(const TileKey &key, const std::shared_ptr<const Tile> &tile){
+        auto entry = index.find(key);
+        if(entry != index.end()){
+            usedBytes -= bytes(*entry->second->second);
+            recent.erase(entry->second);
+            index.erase(entry);
+        }
+        recent.emplace_front(key, tile);
+        index[key] = recent.begin();
+        usedBytes += bytes(*tile);
+        while(usedBytes > budgetBytes && !recent.empty()){
+            usedBytes -= bytes(*recent.back().second);
+            index.erase(recent.back().first);
+            recent.pop_back();
+        }
+    }
+
+    size_t size() const{ return recent.size(); }
+
+    size_t memoryUsed() const{ return usedBytes; }
+
+    uint64_t hitCount() const{ return hits; }
+
+    uint64_t missCount() const{ return misses; }
+
+private:
+    typedef std::list<std::pair<TileKey, std::shared_ptr<const Tile>>> Entries;
+
+    static size_t bytes(const Tile &tile){ return tile.size() * sizeof(uint32_t); }
+
+    size_t budgetBytes;
+    size_t usedBytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    Entries recent;
+    std::unordered_map<TileKey, Entries::iterator, TileKeyHash> index;
+};
+
+} // namespace tiles
+
+#endif // TILE_CACHE_GUARD
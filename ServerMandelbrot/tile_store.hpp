@@ -0,0 +1,162 @@
+#ifndef TILE_STORE_GUARD
+#define TILE_STORE_GUARD
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.hpp"
+#include "tile_cache.hpp"
+
+namespace tiles{
+
+// Tiles kept on disk between runs of the server. The file is append only:
+// a header followed by records, each a RecordHeader and the tile's iteration
+// counts. It is read through a memory mapping, which grows by doubling past
+// the end of the file, and the index of records is rebuilt when the store is
+// opened. A record cut short by a crash is dropped. Tiles that would take the
+// file past maxBytes are not stored.
+class TileStore{
+public:
+    TileStore(const std::string &path, uint64_t maxBytes) : path(path), maxBytes(maxBytes){
+        fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fileDescriptor == -1){
+            LOG(Error) << "Server: // Store    // Cannot open tile store " << path << ". Errno: " << errno;
+            throw -1;
+        }
+        struct stat status;
+        fstat(fileDescriptor, &status);
+        fileSize = status.st_size;
+        if(fileSize == 0){
+            FileHeader header = fileHeader();
+            if(write(fileDescriptor, &header, sizeof(header)) != sizeof(header))
+                throw -1;
+            fileSize = sizeof(header);
+        }
+        remap(fileSize);
+        FileHeader expected = fileHeader();
+        if(fileSize < sizeof(FileHeader) || std::memcmp(mapping, &expected, sizeof(FileHeader)) != 0){
+            LOG(Error) << "Server: // Store    // " << path << " is not a tile store of this version";
+            throw -1;
+        }
+        scan();
+        LOG(Info) << "Server: // Store    // " << index.size() << " tiles in " << path;
+    }
+
+    ~TileStore(){
+        if(mapping)
+            munmap(const_cast<char *>(mapping), mappedSize);
+        close(fileDescriptor);
+    }
+
+    TileStore(const TileStore &) = delete;
+
+    TileStore &operator=(const TileStore &) = delete;
+
+    std::shared_ptr<const Tile> find(const TileKey &key){
+        auto entry = index.find(key);
+        if(entry == index.end())
+            return nullptr;
+        if(entry->second + RecordSize > mappedSize)
+            remap(std::max<uint64_t>(fileSize, uint64_t(mappedSize) * 2));
+        const uint32_t *counters = reinterpret_cast<const uint32_t *>(mapping + entry->second + sizeof(RecordHeader));
+        return std::make_shared<Tile>(counters, counters + TileSize * TileSize);
+    }
+
+    void append(const TileKey &key, const Tile &tile){
+        if(index.count(key) || tile.size() != size_t(TileSize) * TileSize)
+            return;
+        if(fileSize + RecordSize > maxBytes){
+            if(!full)
+                LOG(Warning) << "Server: // Store    // " << path << " reached " << (maxBytes >> 20)
+                             << " MB, no more tiles are stored";
+            full = true;
+            return;
+        }
+        RecordHeader header{key.level, key.maxIterations, key.tx, key.ty};
+        std::string record(RecordSize, '\0');
+        std::memcpy(&record[0], &header, sizeof(header));
+        std::memcpy(&record[sizeof(header)], tile.data(), tile.size() * sizeof(uint32_t));
+        if(pwrite(fileDescriptor, record.data(), record.size(), fileSize) != ssize_t(record.size())){
+            LOG(Warning) << "Server: // Store    // Writing to " << path << " failed. Errno: " << errno;
+            return;
+        }
+        index[key] = fileSize;
+        fileSize += RecordSize;
+    }
+
+    size_t size() const{ return index.size(); }
+
+private:
+    struct FileHeader{
+        char magic[8];
+        uint32_t version;
+        uint32_t tileSize;
+    };
+
+    struct RecordHeader{
+        int32_t level;
+        int32_t maxIterations;
+        int64_t tx;
+        int64_t ty;
+    };
+
+    static const size_t RecordSize = sizeof(RecordHeader) + sizeof(uint32_t) * TileSize * TileSize;
+
+    static FileHeader fileHeader(){
+        FileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "MBTILES", 7);
+        header.version = 1;
+        header.tileSize = TileSize;
+        return header;
+    }
+
+    // Pages past the end of the file are only read once records were written there.
+    void remap(uint64_t size){
+        if(mapping)
+            munmap(const_cast<char *>(mapping), mappedSize);
+        mapping = nullptr;
+        mappedSize = size;
+        void *address = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+        if(address == MAP_FAILED){
+            LOG(Error) << "Server: // Store    // Cannot map " << path << ". Errno: " << errno;
+            throw -1;
+        }
+        mapping = static_cast<const char *>(address);
+    }
+
+    void scan(){
+        uint64_t offset = sizeof(FileHeader);
+        for(; offset + RecordSize <= fileSize; offset += RecordSize){
+            RecordHeader header;
+            std::memcpy(&header, mapping + offset, sizeof(header));
+            index[TileKey{header.level, header.tx, header.ty, header.maxIterations}] = offset;
+        }
+        if(offset != fileSize){
+            LOG(Warning) << "Server: // Store    // Dropping an incomplete record at the end of " << path;
+            if(ftruncate(fileDescriptor, offset) == 0)
+                fileSize = offset;
+        }
+    }
+
+    std::string path;
+    uint64_t maxBytes;
+    bool full = false;
+    int fileDescriptor;
+    uint64_t fileSize;
+    const char *mapping = nullptr;
+    size_t mappedSize = 0;
+    std::unordered_map<TileKey, uint64_t, TileKeyHash> index;
+};
+
+} // namespace tiles
+
+#endif // TILE_STORE_GUARD
@@ -0,0 +1,142 @@
+#ifndef TRACE_GUARD
+#define TRACE_GUARD
+
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+#include "gather.hpp"
+#include "logger.hpp"
+
+// Timeline of what every rank spent its time on, written as a Chrome trace
+// (chrome://tracing, ui.perfetto.dev) with one track per rank. Recording is
+// off until start() and costs two clock reads per scope once on.
+namespace trace{
+
+const size_t MaxEvents = 1 << 20;
+
+struct Event{
+    char name[24];
+    // shown as the event's value, -1 for none
+    int64_t value;
+    double beginMicroseconds;
+    double durationMicroseconds;
+};
+
+class Recorder{
+public:
+    static Recorder &instance(){
+        static Recorder recorder;
+        return recorder;
+    }
+
+    bool enabled() const{ return on; }
+
+    // Collective. Times are measured from a barrier, so ranks line up.
+    void start(){
+        upcxx::barrier();
+        origin = std::chrono::steady_clock::now();
+        on = true;
+    }
+
+    double now() const{
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void record(const char *name, double begin, double end, int64_t value){
+        if(events.size() >= MaxEvents){
+            dropped++;
+            return;
+        }
+        Event event;
+        std::strncpy(event.name, name, sizeof(event.name) - 1);
+        event.name[sizeof(event.name) - 1] = '\0';
+        event.value = value;
+        event.beginMicroseconds = begin;
+        event.durationMicroseconds = end - begin;
+        events.push_back(event);
+    }
+
+    // Collective. Rank 0 gathers the events of every rank and writes them to path.
+    void write(const std::string &path){
+        on = false;
+        std::vector<std::vector<Event>> ranks = gatherToRoot(events);
+        std::vector<std::vector<size_t>> droppedCounts = gatherToRoot(std::vector<size_t>{dropped});
+        if(upcxx::rank_me() != 0)
+            return;
+        std::FILE *file = std::fopen(path.c_str(), "w");
+        if(!file){
+            LOG(Warning) << "Server: // Trace    // Cannot write " << path << ". Errno: " << errno;
+            return;
+        }
+        std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        size_t written = 0;
+        for(size_t rank = 0; rank < ranks.size(); rank++){
+            std::fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %zu, "
+                               "\"args\": {\"name\": \"rank %zu\"}}", rank == 0 ? "" : ",\n", rank, rank);
+            for(const Event &event : ranks[rank]){
+                std::fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %zu, "
+                                   "\"ts\": %.3f, \"dur\": %.3f", event.name, rank,
+                             event.beginMicroseconds, event.durationMicroseconds);
+                if(event.value >= 0)
+                    std::fprintf(file, ", \"args\": {\"value\": %lld}", (long long) event.value);
+                std::fprintf(file, "}");
+                written++;
+            }
+            if(droppedCounts[rank][0] > 0)
+                LOG(Warning) << "Server: // Trace    // Rank " << rank << " dropped " << droppedCounts[rank][0]
+                             << " events over the limit";
+        }
+        std::fprintf(file, "\n]}\n");
+        std::fclose(file);
+        LOG(Info) << "Server: // Trace    // Wrote " << written << " events to " << path;
+    }
+
+private:
+    Recorder() = default;
+
+    bool on = false;
+    std::chrono::steady_clock::time_point origin;
+    std::vector<Event> events;
+    size_t dropped = 0;
+};
+
+// Time for complete(), negative while recording is off.
+inline double now(){
+    return Recorder::instance().enabled() ? Recorder::instance().now() : -1;
+}
+
+// Records an event from begin, a time from now(), until now. For work that
+// ends in a callback rather than at the end of a scope.
+inline void complete(const char *name, double begin, int64_t value = -1){
+    if(begin >= 0 && Recorder::instance().enabled())
+        Recorder::instance().record(name, begin, Recorder::instance().now(), value);
+}
+
+// Records the time from its construction to its destruction as an event.
+class Scope{
+public:
+    explicit Scope(const char *name, int64_t value = -1) : name(name), value(value), begin(now()){}
+
+    ~Scope(){
+        complete(name, begin, value);
+    }
+
+    Scope(const Scope &) = delete;
+
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *name;
+    int64_t value;
+    double begin;
+};
+
+} // namespace trace
+
+#endif // TRACE_GUARD
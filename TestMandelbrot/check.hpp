@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// Plain checks without a test framework. TEST(name) defines a test that
+// runTests() runs; CHECK(condition) reports a condition that does not hold
+// and lets the test carry on. A test that throws fails as a whole.
+//
+//     TEST(partitionCoversEveryRow) {
+//         CHECK(slices.back().rowEnd == rows);
+//     }
+
+struct Test {
+    const char *name;
+    void (*run)();
+};
+
+inline std::vector<Test> &tests() {
+    static std::vector<Test> all;
+    return all;
+}
+
+inline int &failures() {
+    static int count = 0;
+    return count;
+}
+
+struct TestRegistration {
+    TestRegistration(const char *name, void (*run)()) {
+        tests().push_back(Test{name, run});
+    }
+};
+
+#define TEST(name) \
+    void name(); \
+    TestRegistration name##Registration(#name, name); \
+    void name()
+
+#define CHECK(condition) ((condition) ? (void) 0 : checkFailed(#condition, __FILE__, __LINE__))
+
+inline void checkFailed(const char *condition, const char *file, int line) {
+    std::printf("%s:%d: CHECK(%s) failed\n", file, line, condition);
+    failures()++;
+}
+
+// Runs every test in the order they are defined, 1 when any of them failed.
+inline int runTests() {
+    for (const Test &test : tests()) {
+        int before = failures();
+        try {
+            test.run();
+        } catch (...) {
+            std::printf("%s threw\n", test.name);
+            failures()++;
+        }
+        std::printf("%-40s %s\n", test.name, failures() == before ? "ok" : "FAILED");
+    }
+    return failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "check.hpp"
+#include "Session.h"
+#include "SnapshotStack.h"
+
+// Tests of the client's library that need no window and no server.
+
+namespace {
+
+ApplicationState stateOfSize(int width, int height, int debugView = 0) {
+    ApplicationState state;
+    state.windowWidth = width;
+    state.windowHeight = height;
+    state.debugView = debugView;
+    return state;
+}
+
+// Bands of one color, longer than a run can be, with single odd pixels between them.
+std::vector<Pixel> bandedImage(int width, int height) {
+    std::vector<Pixel> image(size_t(width) * height);
+    for (size_t i = 0; i < image.size(); i++) {
+        uint8_t band = uint8_t(i / 700);
+        image[i] = i % 333 == 0 ? Pixel{255, 0, band} : Pixel{band, uint8_t(band * 3), 7};
+    }
+    return image;
+}
+
+std::vector<Pixel> noisyImage(int width, int height) {
+    std::vector<Pixel> image(size_t(width) * height);
+    uint32_t random = 7;
+    for (Pixel &pixel : image) {
+        random = random * 1103515245 + 12345;
+        pixel = Pixel{uint8_t(random >> 24), uint8_t(random >> 16), uint8_t(random >> 8)};
+    }
+    return image;
+}
+
+// Session file of the given lines, removed again when it goes out of scope.
+class SessionFile {
+public:
+    explicit SessionFile(const std::string &lines)
+            : path("/tmp/TestMandelbrot." + std::to_string(getpid()) + ".session") {
+        std::ofstream(path) << lines;
+    }
+
+    ~SessionFile() {
+        std::remove(path.c_str());
+    }
+
+    const std::string path;
+};
+
+bool rejected(const std::string &lines) {
+    try {
+        readSession(SessionFile(lines).path);
+    } catch (const CannotReadSessionException &) {
+        return true;
+    }
+    return false;
+}
+
+bool samePixels(const std::vector<Pixel> &a, const std::vector<Pixel> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].red != b[i].red || a[i].green != b[i].green || a[i].blue != b[i].blue) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST(snapshotRestoresRunLengthEncodedImages) {
+    SnapshotStack stack;
+    std::vector<Pixel> image = bandedImage(120, 90);
+    stack.push(stateOfSize(120, 90), image);
+    CHECK(stack.memoryUsed() < image.size() * sizeof(Pixel) / 4);
+    std::vector<Pixel> restored;
+    CHECK(stack.restoreTopImage(restored, 120, 90, 0));
+    CHECK(samePixels(restored, image));
+}
+
+TEST(snapshotKeepsNoisyImagesPlain) {
+    SnapshotStack stack;
+    std::vector<Pixel> image = noisyImage(64, 48);
+    stack.push(stateOfSize(64, 48), image);
+    CHECK(stack.memoryUsed() == image.size() * sizeof(Pixel));
+    std::vector<Pixel> restored;
+    CHECK(stack.restoreTopImage(restored, 64, 48, 0));
+    CHECK(samePixels(restored, image));
+}
+
+TEST(snapshotMatchesWindowAndDebugView) {
+    SnapshotStack stack;
+    std::vector<Pixel> restored;
+    stack.push(stateOfSize(64, 48, 1), bandedImage(64, 48));
+    CHECK(!stack.restoreTopImage(restored, 48, 64, 1));
+    CHECK(!stack.restoreTopImage(restored, 64, 48, 0));
+    CHECK(stack.restoreTopImage(restored, 64, 48, 1));
+    stack.push(stateOfSize(64, 48), bandedImage(64, 48), false);
+    CHECK(!stack.restoreTopImage(restored, 64, 48, 0));
+    stack.push(stateOfSize(64, 48), bandedImage(32, 48));
+    CHECK(!stack.restoreTopImage(restored, 64, 48, 0));
+}
+
+TEST(snapshotDropsTheOldestImagesOverTheCap) {
+    std::vector<Pixel> image = noisyImage(64, 48);
+    SnapshotStack stack(image.size() * sizeof(Pixel) * 2);
+    for (int n = 0; n < 3; n++) {
+        stack.push(stateOfSize(64, 48), image);
+    }
+    CHECK(stack.memoryUsed() == image.size() * sizeof(Pixel) * 2);
+    std::vector<Pixel> restored;
+    CHECK(stack.restoreTopImage(restored, 64, 48, 0));
+    stack.pop();
+    CHECK(stack.restoreTopImage(restored, 64, 48, 0));
+    stack.pop();
+    CHECK(!stack.restoreTopImage(restored, 64, 48, 0));
+    CHECK(stack.memoryUsed() == 0);
+    stack.pop();
+    CHECK(stack.empty());
+}
+
+TEST(sessionReadsStepsWithAndWithoutDebugView) {
+    SessionFile file("# action width height leftTopX leftTopY rightBottomX rightBottomY debugView\n"
+                     "start 600 720 -2 1.5 0.5 -1.5\n"
+                     "\n"
+                     "zoom 600 720 -0.75 0.25 -0.5 0.0625 2\n"
+                     "debug 300 200 -2 1.5 0.5 -1.5 1\n");
+    std::vector<SessionStep> steps = readSession(file.path);
+    CHECK(steps.size() == 3);
+    CHECK(steps[0].action == "start" && steps[0].request.windowWidth == 600 && steps[0].request.windowHeight == 720);
+    CHECK(steps[0].request.leftTopX == -2 && steps[0].request.rightBottomY == -1.5);
+    CHECK(steps[0].request.debugView == NoDebugView && steps[0].request.requestType == FrameRequest);
+    CHECK(steps[1].action == "zoom" && steps[1].request.leftTopY == 0.25 && steps[1].request.rightBottomY == 0.0625);
+    CHECK(steps[1].request.debugView == CostView);
+    CHECK(steps[2].request.windowWidth == 300 && steps[2].request.debugView == OwnershipView);
+}
+
+TEST(sessionRejectsWhatIsNotAStep) {
+    CHECK(rejected("start 600 720 -2 1.5 0.5\n"));
+    CHECK(rejected("start 600 720 -2 1.5 0.5 -1.5 3\n"));
+    CHECK(rejected("start 600 720 -2 1.5 0.5 -1.5 -1\n"));
+    CHECK(rejected("start 600 720 -2 1.5 0.5 -1.5 cost\n"));
+    CHECK(rejected("start wide 720 -2 1.5 0.5 -1.5\n"));
+    CHECK(!rejected("start 600 720 -2 1.5 0.5 -1.5 0\n"));
+    bool threw = false;
+    try {
+        readSession("/nonexistent/session");
+    } catch (const CannotReadSessionException &) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+int main() {
+    return runTests();
+}
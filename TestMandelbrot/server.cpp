@@ -0,0 +1,322 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "check.hpp"
+#include "checkpoint.hpp"
+#include "deflate.hpp"
+#include "engine.hpp"
+#include "image_writer.hpp"
+#include "pyramid.hpp"
+#include "renderer.hpp"
+
+// Tests of the server's headers that need no running ranks.
+
+namespace {
+
+// Inflates the blocks deflate::compress() writes: stored blocks and blocks of
+// the fixed Huffman code, none of them final. Throws on anything else.
+class Inflater {
+public:
+    explicit Inflater(const std::vector<unsigned char> &in) : in(in) {}
+
+    std::vector<unsigned char> run() {
+        while (position < in.size()) {
+            if (bit(1) != 0) {
+                throw "final block";
+            }
+            int type = int(bits(2));
+            if (type == 0) {
+                stored();
+            } else if (type == 1) {
+                fixed();
+            } else {
+                throw "dynamic Huffman block";
+            }
+        }
+        return out;
+    }
+
+private:
+    uint32_t bit(int) {
+        if (position >= in.size()) {
+            throw "stream cut short";
+        }
+        uint32_t value = (in[position] >> offset) & 1;
+        if (++offset == 8) {
+            offset = 0;
+            position++;
+        }
+        return value;
+    }
+
+    // count bits, least significant first
+    uint32_t bits(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++) {
+            value |= bit(1) << i;
+        }
+        return value;
+    }
+
+    // a Huffman code, most significant bit first
+    uint32_t code(int length, uint32_t value = 0) {
+        for (int i = 0; i < length; i++) {
+            value = value << 1 | bit(1);
+        }
+        return value;
+    }
+
+    void stored() {
+        if (offset != 0) {
+            offset = 0;
+            position++;
+        }
+        if (position + 4 > in.size()) {
+            throw "stored block cut short";
+        }
+        size_t length = in[position] | in[position + 1] << 8;
+        size_t inverse = in[position + 2] | in[position + 3] << 8;
+        if ((length ^ 0xffff) != inverse || position + 4 + length > in.size()) {
+            throw "bad stored block";
+        }
+        out.insert(out.end(), in.begin() + position + 4, in.begin() + position + 4 + length);
+        position += 4 + length;
+    }
+
+    int literal() {
+        uint32_t value = code(7);
+        if (value <= 23) {
+            return 256 + value;
+        }
+        value = code(1, value);
+        if (value >= 0x30 && value <= 0xbf) {
+            return value - 0x30;
+        }
+        if (value >= 0xc0 && value <= 0xc7) {
+            return 280 + value - 0xc0;
+        }
+        return 144 + code(1, value) - 0x190;
+    }
+
+    void fixed() {
+        static const int lengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+                                         67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const int lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                          4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const int distanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                           513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const int distanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8,
+                                            9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        while (true) {
+            int symbol = literal();
+            if (symbol < 256) {
+                out.push_back(uint8_t(symbol));
+                continue;
+            }
+            if (symbol == 256) {
+                return;
+            }
+            int length = lengthBase[symbol - 257] + int(bits(lengthExtra[symbol - 257]));
+            int distanceCode = int(code(5));
+            size_t distance = distanceBase[distanceCode] + bits(distanceExtra[distanceCode]);
+            if (distance > out.size()) {
+                throw "match before the start";
+            }
+            for (int i = 0; i < length; i++) {
+                out.push_back(out[out.size() - distance]);
+            }
+        }
+    }
+
+    const std::vector<unsigned char> &in;
+    size_t position = 0;
+    int offset = 0;
+    std::vector<unsigned char> out;
+};
+
+std::vector<unsigned char> inflate(const std::vector<unsigned char> &blocks) {
+    return Inflater(blocks).run();
+}
+
+// Bytes like scanlines of a render: long runs with some noise in between.
+std::vector<unsigned char> scanlines(size_t size) {
+    std::vector<unsigned char> data(size);
+    uint32_t random = 12345;
+    for (size_t i = 0; i < size; i++) {
+        random = random * 1103515245 + 12345;
+        data[i] = (i / 97) % 7 == 0 ? uint8_t(random >> 24) : uint8_t(i / 300);
+    }
+    return data;
+}
+
+}
+
+TEST(deflateRoundTripsAcrossChunks) {
+    std::vector<unsigned char> data = scanlines(deflate::ChunkSize * 2 + 1234);
+    std::vector<unsigned char> blocks = deflate::compress(data.data(), data.size(), 3);
+    CHECK(blocks.size() < data.size() / 2);
+    CHECK(inflate(blocks) == data);
+}
+
+TEST(deflateDoesNotDependOnThreads) {
+    std::vector<unsigned char> data = scanlines(deflate::ChunkSize * 3);
+    CHECK(deflate::compress(data.data(), data.size(), 1) == deflate::compress(data.data(), data.size(), 4));
+}
+
+TEST(deflateStoresWhatDoesNotCompress) {
+    std::vector<unsigned char> data(100000);
+    uint32_t random = 1;
+    for (unsigned char &byte : data) {
+        random = random * 1103515245 + 12345;
+        byte = uint8_t(random >> 24);
+    }
+    std::vector<unsigned char> blocks = deflate::compress(data.data(), data.size(), 1);
+    CHECK(blocks.size() <= data.size() + data.size() / 65535 * 5 + 5);
+    CHECK(inflate(blocks) == data);
+    CHECK(inflate(deflate::compress(data.data(), data.size(), 0)) == data);
+}
+
+TEST(deflateHandlesTinyInputs) {
+    for (size_t size = 0; size < 5; size++) {
+        std::vector<unsigned char> data(size, 'a');
+        CHECK(inflate(deflate::compress(data.data(), data.size(), 1)) == data);
+    }
+}
+
+TEST(checksumsMatchKnownValues) {
+    const unsigned char text[] = "123456789";
+    CHECK(image::crc32(0, text, 9) == 0xcbf43926u);
+    CHECK(image::crc32(image::crc32(0, text, 4), text + 4, 5) == 0xcbf43926u);
+    CHECK(image::adler32(1, text, 9) == 0x091e01deu);
+}
+
+TEST(partitionCoversEveryRowOnce) {
+    std::vector<engine::Job> jobs = {engine::Job{0, 0, 1, 1, 0, 0, 640, 480, 256, engine::Mapping::Linear, 0},
+                                     engine::Job{0, 0, 1, 1, 0, 0, 64, 7, 256, engine::Mapping::Linear, 0},
+                                     engine::Job{0, 0, 1, 1, 0, 0, 1000, 3, 256, engine::Mapping::Linear, 0}};
+    for (int workers = 1; workers <= 9; workers++) {
+        std::vector<engine::Slice> slices = engine::partition(jobs, workers);
+        CHECK(int(slices.size()) == workers);
+        CHECK(slices.front().rowBegin == 0 && slices.front().pixelBegin == 0);
+        CHECK(slices.back().rowEnd == 490 && slices.back().pixelEnd == engine::pixelCount(jobs));
+        for (int worker = 1; worker < workers; worker++) {
+            CHECK(slices[worker].rowBegin == slices[worker - 1].rowEnd);
+            CHECK(slices[worker].pixelBegin == slices[worker - 1].pixelEnd);
+        }
+    }
+}
+
+TEST(partitionBalancesPixels) {
+    std::vector<engine::Job> jobs = {engine::Job{0, 0, 1, 1, 0, 0, 800, 600, 256, engine::Mapping::Linear, 0}};
+    for (const engine::Slice &slice : engine::partition(jobs, 7)) {
+        int64_t pixels = slice.pixelEnd - slice.pixelBegin;
+        CHECK(pixels >= 800 * 600 / 7 - 800 && pixels <= 800 * 600 / 7 + 800);
+        CHECK(pixels == (slice.rowEnd - slice.rowBegin) * 800);
+    }
+}
+
+TEST(partitionLeavesSpareWorkersEmpty) {
+    std::vector<engine::Job> jobs = {engine::Job{0, 0, 1, 1, 0, 0, 10, 2, 256, engine::Mapping::Linear, 0}};
+    std::vector<engine::Slice> slices = engine::partition(jobs, 5);
+    int busy = 0;
+    for (const engine::Slice &slice : slices) {
+        busy += slice.rowEnd > slice.rowBegin;
+    }
+    CHECK(busy == 2);
+    CHECK(slices.back().rowEnd == 2 && slices.back().pixelEnd == 20);
+    CHECK(engine::partition({}, 3).back().rowEnd == 0);
+}
+
+TEST(checkpointRecordReadsBackInOrder) {
+    checkpoint::Record record;
+    record.put(42);
+    record.putBytes("strip", 5);
+    record.put(2.5);
+    checkpoint::Record read(record.bytes());
+    CHECK(read.get<int>() == 42);
+    CHECK(read.getBytes() == "strip");
+    CHECK(read.get<double>() == 2.5);
+    bool threw = false;
+    try {
+        read.get<int>();
+    } catch (int) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST(checkpointResumesOnlyTheSameRender) {
+    std::string path = "/tmp/TestMandelbrot." + std::to_string(getpid()) + ".checkpoint";
+    Viewport view{64, 48, -2, 1, 1, -1};
+    std::string parameters = checkpoint::describe("batch", view, 256);
+    {
+        checkpoint::Checkpoint fresh(path, parameters, 1);
+        CHECK(fresh.enabled() && !fresh.resuming());
+        checkpoint::Record record;
+        record.put(int64_t(1234));
+        record.putBytes("rows", 4);
+        fresh.save(record);
+    }
+    {
+        checkpoint::Checkpoint resumed(path, parameters, 1);
+        CHECK(resumed.resuming());
+        CHECK(resumed.restored().get<int64_t>() == 1234);
+        CHECK(resumed.restored().getBytes() == "rows");
+    }
+    CHECK(!checkpoint::Checkpoint(path, checkpoint::describe("batch", view, 512), 1).resuming());
+    CHECK(!checkpoint::Checkpoint(path, parameters, 0).resuming());
+    checkpoint::Checkpoint(path, parameters, 1).remove();
+    CHECK(access(path.c_str(), F_OK) != 0);
+}
+
+TEST(pyramidLevelsHalveDownToOnePixel) {
+    CHECK(pyramid::levelCount(1, 1) == 1);
+    CHECK(pyramid::levelCount(2, 1) == 2);
+    CHECK(pyramid::levelCount(256, 256) == 9);
+    CHECK(pyramid::levelCount(257, 100) == 10);
+    CHECK(pyramid::levelCount(100, 1 << 20) == 21);
+    int width = 1000;
+    int height = 333;
+    int levels = pyramid::levelCount(width, height);
+    CHECK(levels == 11);
+    CHECK(pyramid::levelSize(width, 0) == 1000 && pyramid::levelSize(height, 0) == 333);
+    CHECK(pyramid::levelSize(width, 1) == 500 && pyramid::levelSize(height, 1) == 167);
+    CHECK(pyramid::levelSize(width, 3) == 125 && pyramid::levelSize(height, 3) == 42);
+    CHECK(pyramid::levelSize(width, levels - 1) == 1 && pyramid::levelSize(height, levels - 1) == 1);
+    for (int shift = 1; shift < levels; shift++) {
+        CHECK(pyramid::levelSize(width, shift) == (pyramid::levelSize(width, shift - 1) + 1) / 2);
+    }
+    CHECK(pyramid::levelSize(2000000000, 30) == 2);
+}
+
+TEST(tiledRenderingMatchesExactOnTheGrid) {
+    engine::Engine engine;
+    // a step of 1/128 from corners on multiples of it puts every pixel on a tile point of level 7
+    Viewport view{300, 200, -2, 1.5, -2 + 300 / 128.0, 1.5 - 200 / 128.0};
+    FrameRenderer exact(engine, 0);
+    FrameRenderer cached(engine, size_t(64) << 20);
+    std::vector<uint32_t> expected = exact.render(view, 256);
+    CHECK(expected.size() == 300 * 200);
+    CHECK(cached.render(view, 256) == expected);
+    CHECK(cached.tileCache().missCount() > 0 && cached.tileCache().hitCount() == 0);
+    CHECK(cached.render(view, 256, {Region{0, 0, 300, 200}}) == expected);
+    CHECK(cached.tileCache().hitCount() > 0);
+}
+
+TEST(tiledRenderingFallsBackForEmptyWindows) {
+    engine::Engine engine;
+    FrameRenderer cached(engine, size_t(64) << 20);
+    CHECK(cached.render(Viewport{0, 0, -2, 1.5, 0.5, -1.5}, 256).empty());
+    CHECK(cached.render(Viewport{0, 0, -2, 1.5, -2, 1.5}, 256).empty());
+    CHECK(cached.render(Viewport{0, 10, -2, 1.5, 0.5, -1.5}, 256).empty());
+    CHECK(cached.tileCache().missCount() == 0);
+}
+
+int main() {
+    upcxx::init();
+    int status = runTests();
+    upcxx::finalize();
+    return status;
+}